@@ -0,0 +1,171 @@
+#include "concurrentpool.h"
+#include "mempool.h"
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* SCRATCH TESTS: a request allocates ~64K of small objects and throws them away */
+
+constexpr ui32 RequestObjects = 2048;
+struct TScratch {
+    ui64 X[4];
+};
+
+static void POOL_REQUEST_REALLOCATE(benchmark::State& state) {
+    NMemory::TPool<NMemory::TExponentialStrategy> pool;
+    for(auto _ : state) {
+        for(ui32 i=0; i<RequestObjects; ++i)
+            benchmark::DoNotOptimize(pool.Emplace<TScratch>());
+        pool.ReAllocate();
+    }
+    state.SetItemsProcessed(state.iterations() * RequestObjects);
+}
+static void POOL_REQUEST_RESET(benchmark::State& state) {
+    NMemory::TPool<NMemory::TExponentialStrategy> pool;
+    for(auto _ : state) {
+        for(ui32 i=0; i<RequestObjects; ++i)
+            benchmark::DoNotOptimize(pool.Emplace<TScratch>());
+        pool.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * RequestObjects);
+}
+static void POOL_REQUEST_SCOPE(benchmark::State& state) {
+    NMemory::TPool<NMemory::TExponentialStrategy> pool;
+    for(auto _ : state) {
+        NMemory::TPool<NMemory::TExponentialStrategy>::TScope scope(pool);
+        for(ui32 i=0; i<RequestObjects; ++i)
+            benchmark::DoNotOptimize(pool.Emplace<TScratch>());
+    }
+    state.SetItemsProcessed(state.iterations() * RequestObjects);
+}
+
+BENCHMARK(POOL_REQUEST_REALLOCATE);
+BENCHMARK(POOL_REQUEST_RESET);
+BENCHMARK(POOL_REQUEST_SCOPE);
+
+/* BATCH TESTS: each cycle rebuilds a ~1M structure from a 4K first block with a reuse policy */
+
+constexpr ui32 BatchObjects = 1 << 15;
+using TBatchPool = NMemory::TPool<NMemory::TLinearStrategy>;
+
+static void BATCH(TBatchPool& pool) {
+    for(ui32 i=0; i<BatchObjects; ++i)
+        benchmark::DoNotOptimize(pool.Emplace<TScratch>());
+}
+static void POOL_BATCH_REALLOCATE(benchmark::State& state) {
+    TBatchPool pool;
+    for(auto _ : state) {
+        BATCH(pool);
+        pool.ReAllocate();
+    }
+    state.SetItemsProcessed(state.iterations() * BatchObjects);
+}
+static void POOL_BATCH_RIGHTSIZE(benchmark::State& state) {
+    TBatchPool pool;
+    for(auto _ : state) {
+        BATCH(pool);
+        pool.RightSize();
+    }
+    state.SetItemsProcessed(state.iterations() * BatchObjects);
+    state.SetLabel("Blocks=" + std::to_string(pool.BlocksCount()));
+}
+static void POOL_BATCH_RETAIN(benchmark::State& state) {
+    TBatchPool pool;
+    for(auto _ : state) {
+        BATCH(pool);
+        pool.Retain(pool.BlocksCount());
+    }
+    state.SetItemsProcessed(state.iterations() * BatchObjects);
+    state.SetLabel("Blocks=" + std::to_string(pool.BlocksCount()));
+}
+
+BENCHMARK(POOL_BATCH_REALLOCATE);
+BENCHMARK(POOL_BATCH_RIGHTSIZE);
+BENCHMARK(POOL_BATCH_RETAIN);
+
+/* GROW TESTS: a buffer doubles its capacity from 16 bytes to 64K in the arena */
+
+constexpr size_t GrowSize = 1 << 16;
+
+template<bool Extend>
+static void POOL_GROW(benchmark::State& state) {
+    NMemory::TPool<NMemory::TExponentialStrategy> pool(1 << 18);
+    for(auto _ : state) {
+        size_t capacity = 16;
+        char* buf = static_cast<char*>(pool.Allocate(capacity, 1));
+        for(size_t size=0; size<GrowSize; size+=16) {
+            if (size == capacity) {
+                if (!Extend || !pool.TryExtend(buf, capacity, capacity * 2)) {
+                    char* next = static_cast<char*>(pool.Allocate(capacity * 2, 1));
+                    std::memcpy(next, buf, capacity);
+                    buf = next;
+                }
+                capacity *= 2;
+            }
+            std::memset(buf + size, 1, 16);
+        }
+        benchmark::DoNotOptimize(buf);
+        pool.Reset();
+    }
+    state.SetBytesProcessed(state.iterations() * GrowSize);
+}
+
+BENCHMARK_TEMPLATE(POOL_GROW, false);
+BENCHMARK_TEMPLATE(POOL_GROW, true);
+
+/* CONCURRENT TESTS: allocations per second from 1..N threads, the memory is freed outside timing */
+
+constexpr ui32 ThreadObjects = 1 << 14;
+constexpr ui32 ThreadIterations = 32;
+static const int MaxThreads = std::max(1U, std::thread::hardware_concurrency());
+struct TThreadNode {
+    ui64 Key;
+    TThreadNode* Left;
+    TThreadNode* Right;
+};
+
+/* the pool shared by the threads of one run: the first thread creates it, the last one frees it
+ * (the threads of the previous run are joined by then, so it's a new pool for each run)
+ */
+static std::shared_ptr<NMemory::TConcurrentPool<>> SharedPoolInRun() {
+    static std::mutex lock;
+    static std::weak_ptr<NMemory::TConcurrentPool<>> current;
+    std::lock_guard guard(lock);
+    std::shared_ptr<NMemory::TConcurrentPool<>> shared = current.lock();
+    if (!shared) {
+        shared = std::make_shared<NMemory::TConcurrentPool<>>(1 << 20);
+        current = shared;
+    }
+    return shared;
+}
+static void POOL_CONCURRENT_ALLOCATE(benchmark::State& state) {
+    const auto pool = SharedPoolInRun();
+    NMemory::TConcurrentPool<>::TShard shard(*pool); // destroyed before the pool
+    for(auto _ : state)
+        for(ui32 i=0; i<ThreadObjects; ++i)
+            benchmark::DoNotOptimize(shard.Emplace<TThreadNode>());
+    if (state.thread_index == 0)
+        state.SetLabel("Blocks=" + std::to_string(pool->BlocksCount()));
+    state.SetItemsProcessed(state.iterations() * ThreadObjects);
+}
+static void POOL_MALLOC_ALLOCATE(benchmark::State& state) {
+    std::vector<void*> ptrs;
+    ptrs.reserve(ThreadIterations * ThreadObjects);
+    for(auto _ : state)
+        for(ui32 i=0; i<ThreadObjects; ++i)
+            ptrs.push_back(std::malloc(sizeof(TThreadNode)));
+    state.PauseTiming();
+    for(void* p: ptrs)
+        std::free(p);
+    state.ResumeTiming();
+    state.SetItemsProcessed(state.iterations() * ThreadObjects);
+}
+
+BENCHMARK(POOL_CONCURRENT_ALLOCATE)->Iterations(ThreadIterations)->ThreadRange(1, MaxThreads)->UseRealTime();
+BENCHMARK(POOL_MALLOC_ALLOCATE)->Iterations(ThreadIterations)->ThreadRange(1, MaxThreads)->UseRealTime();
@@ -1,13 +1,28 @@
+#include "adaptivetree.h"
+#include "concurrenttree.h"
+#include "frozentree.h"
 #include "prefixdfa.h"
 #include "prefixdfamem.h"
+#include "prefixmap.h"
 #include "prefixtree.h"
+#include "mmapsource.h"
+#include "poolresource.h"
 #include "rbset.h"
+#include "stringpool.h"
 #include "benchmark/benchmark.h"
+#include "b_stats.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <deque>
+#include <random>
 #include <set>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 class TWarAndPiece{
@@ -34,6 +49,8 @@ struct TTest {
     NPrefix::TDfa Dfa;
     NPrefix::NMemoryOptimized::TDfa DfaMO;
     NPrefix::TTree PrefixTree;
+    NPrefix::TAdaptiveTree AdaptiveTree;
+    NPrefix::TFrozenTree FrozenTree;
     NRBTree::TSet<std::string> RBTree;
     std::set<std::string> StlSet;
     std::unordered_set<std::string> StlUOSet;
@@ -43,13 +60,17 @@ struct TTest {
             Dfa.insert(word);
             DfaMO.insert(word);
             PrefixTree.Append(word);
+            AdaptiveTree.Append(word);
             RBTree.insert(word);
             StlSet.insert(word);
             StlUOSet.insert(word);
         }
+        FrozenTree = NPrefix::TFrozenTree::Freeze(PrefixTree);
     }
 } t;
 
+static const int MaxThreads = std::max(2U, std::thread::hardware_concurrency());
+
 /* SEARCH KEY TEST */
 
 static void SMALL_STLUNORDEREDSET_SEARCH_LONG_WORD(benchmark::State& state) {
@@ -148,6 +169,14 @@ static void PREFIX_PREFIXTREE_INSERT(benchmark::State& state) {
     }
     state.SetLabel("Words="+std::to_string(wap.size())+",size="+std::to_string(tree.size()));
 }
+static void PREFIX_ADAPTIVETREE_INSERT(benchmark::State& state) {
+    NPrefix::TAdaptiveTree tree;
+    for(auto _ : state) {
+        for(const auto& word: wap)
+            tree.Append(word);
+    }
+    state.SetLabel("Words="+std::to_string(wap.size())+",size="+std::to_string(tree.size()));
+}
 static void PREFIX_RBTREE_INSERT(benchmark::State& state) {
     NRBTree::TSet<std::string> set;
     for(auto _ : state) {
@@ -165,13 +194,161 @@ static void PREFIX_STLSET_INSERT(benchmark::State& state) {
     state.SetLabel("Words="+std::to_string(wap.size())+",size="+std::to_string(set.size()));
 }
 
+static void PREFIX_DFA_INSERT_ARENA(benchmark::State& state) {
+    NMemory::TPoolResource<> arena;
+    NPrefix::NPmr::TDfa dfa(&arena);
+    for(auto _ : state) {
+        for(const auto& word: wap)
+            dfa.insert(word);
+    }
+    ReportStats(state, arena.Stats());
+    state.SetLabel("Words="+std::to_string(wap.size())+",size="+std::to_string(dfa.size()));
+}
+static void PREFIX_PREFIXTREE_INSERT_ARENA(benchmark::State& state) {
+    NMemory::TPoolResource<> arena;
+    NPrefix::NPmr::TTree tree(&arena);
+    for(auto _ : state) {
+        for(const auto& word: wap)
+            tree.Append(word);
+    }
+    ReportStats(state, arena.Stats());
+    state.SetLabel("Words="+std::to_string(wap.size())+",size="+std::to_string(tree.size()));
+}
+
 BENCHMARK(PREFIX_DFA_INSERT);
+BENCHMARK(PREFIX_DFA_INSERT_ARENA);
 BENCHMARK(PREFIX_DFAMO_INSERT);
 BENCHMARK(PREFIX_STLUNORDEREDSET_INSERT);
 BENCHMARK(PREFIX_PREFIXTREE_INSERT);
+BENCHMARK(PREFIX_PREFIXTREE_INSERT_ARENA);
+BENCHMARK(PREFIX_ADAPTIVETREE_INSERT);
 BENCHMARK(PREFIX_RBTREE_INSERT);
 BENCHMARK(PREFIX_STLSET_INSERT);
 
+/* BUILD TESTS: a fresh container per iteration, its destruction included */
+
+static void PREFIX_DFA_BUILD(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TDfa dfa;
+        for(const auto& word: wap)
+            dfa.insert(word);
+    }
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_DFA_BUILD_ARENA(benchmark::State& state) {
+    NMemory::TStats stats;
+    for(auto _ : state) {
+        NMemory::TPoolResource<> arena;
+        NPrefix::NPmr::TDfa dfa(&arena);
+        for(const auto& word: wap)
+            dfa.insert(word);
+        stats = arena.Stats();
+    }
+    ReportStats(state, stats);
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_PREFIXTREE_BUILD(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TTree tree;
+        for(const auto& word: wap)
+            tree.Append(word);
+    }
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_ADAPTIVETREE_BUILD(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TAdaptiveTree tree;
+        for(const auto& word: wap)
+            tree.Append(word);
+    }
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_PREFIXTREE_BUILD_SORTED(benchmark::State& state) {
+    NPrefix::TKeyRefs sorted(wap.begin(), wap.end());
+    std::sort(sorted.begin(), sorted.end());
+    for(auto _ : state) {
+        NPrefix::TTree tree;
+        tree.BuildFromSorted(sorted);
+    }
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_PREFIXTREE_BUILD_UNSORTED(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TTree tree;
+        tree.BuildFromUnsorted(wap);
+    }
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_PREFIXTREE_BUILD_PARALLEL(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TTree tree;
+        tree.BuildParallel(wap, state.range(0));
+    }
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_FROZENTREE_FREEZE(benchmark::State& state) {
+    for(auto _ : state)
+        benchmark::DoNotOptimize(NPrefix::TFrozenTree::Freeze(t.PrefixTree));
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+static void PREFIX_PREFIXTREE_BUILD_ARENA(benchmark::State& state) {
+    NMemory::TStats stats;
+    for(auto _ : state) {
+        NMemory::TPoolResource<> arena;
+        NPrefix::NPmr::TTree tree(&arena);
+        for(const auto& word: wap)
+            tree.Append(word);
+        stats = arena.Stats();
+    }
+    ReportStats(state, stats);
+    state.SetLabel("Words="+std::to_string(wap.size()));
+}
+
+BENCHMARK(PREFIX_DFA_BUILD);
+BENCHMARK(PREFIX_DFA_BUILD_ARENA);
+BENCHMARK(PREFIX_PREFIXTREE_BUILD);
+BENCHMARK(PREFIX_PREFIXTREE_BUILD_SORTED);
+BENCHMARK(PREFIX_PREFIXTREE_BUILD_UNSORTED)->UseRealTime();
+BENCHMARK(PREFIX_PREFIXTREE_BUILD_PARALLEL)->RangeMultiplier(2)->Range(1, MaxThreads)->UseRealTime();
+BENCHMARK(PREFIX_PREFIXTREE_BUILD_ARENA);
+BENCHMARK(PREFIX_ADAPTIVETREE_BUILD);
+BENCHMARK(PREFIX_FROZENTREE_FREEZE);
+
+/* INGEST TESTS: keeping every word vs interning the distinct ones */
+
+static void PREFIX_DEQUE_INGEST(benchmark::State& state) {
+    size_t bytes = 0;
+    for(auto _ : state) {
+        std::deque<std::string> words;
+        for(const auto& word: wap)
+            words.push_back(word);
+        bytes = words.size() * sizeof(std::string);
+        for(const auto& w: words)
+            if (w.capacity() > std::string().capacity()) // out of the SSO buffer
+                bytes += w.capacity() + 1;
+    }
+    state.SetItemsProcessed(state.iterations() * wap.size());
+    state.counters["Reserved"] = benchmark::Counter(bytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+    state.SetLabel("Words=" + std::to_string(wap.size()));
+}
+static void PREFIX_STRINGPOOL_INGEST(benchmark::State& state) {
+    NMemory::TStats stats;
+    size_t size = 0;
+    for(auto _ : state) {
+        NMemory::TStringPool<> strings;
+        for(const auto& word: wap)
+            benchmark::DoNotOptimize(strings.Intern(word));
+        stats = strings.Stats();
+        size = strings.size();
+    }
+    state.SetItemsProcessed(state.iterations() * wap.size());
+    ReportStats(state, stats);
+    state.SetLabel("Words=" + std::to_string(wap.size()) + ",size=" + std::to_string(size));
+}
+
+BENCHMARK(PREFIX_DEQUE_INGEST);
+BENCHMARK(PREFIX_STRINGPOOL_INGEST);
+
 /* AGGREGATE SEARCH TEST */
 
 static void PREFIX_DFA_SEARCH(benchmark::State& state) {
@@ -214,6 +391,22 @@ static void PREFIX_PREFIXTREE_SEARCH(benchmark::State& state) {
                 std::cout << "BROKEN TREE ON WORD " << word << "\n";
     state.SetLabel("Words=" + std::to_string(wap.size()));
 }
+static void PREFIX_ADAPTIVETREE_SEARCH(benchmark::State& state) {
+    const auto& tree = t.AdaptiveTree;
+    for(auto _ : state)
+        for(const auto& word: wap)
+            if (!tree.Exists(word))
+                std::cout << "BROKEN TREE ON WORD " << word << "\n";
+    state.SetLabel("Words=" + std::to_string(wap.size()));
+}
+static void PREFIX_FROZENTREE_SEARCH(benchmark::State& state) {
+    const auto& tree = t.FrozenTree;
+    for(auto _ : state)
+        for(const auto& word: wap)
+            if (!tree.Exists(word))
+                std::cout << "BROKEN TREE ON WORD " << word << "\n";
+    state.SetLabel("Words=" + std::to_string(wap.size()) + ",Bytes=" + std::to_string(tree.Image().size()));
+}
 static void PREFIX_RBTREE_SEARCH(benchmark::State& state) {
     const auto& set = t.RBTree;
     for(auto _ : state)
@@ -227,10 +420,327 @@ BENCHMARK(PREFIX_DFA_SEARCH);
 BENCHMARK(PREFIX_DFAMO_SEARCH);
 BENCHMARK(PREFIX_STLUNORDEREDSET_SEARCH);
 BENCHMARK(PREFIX_PREFIXTREE_SEARCH);
+BENCHMARK(PREFIX_ADAPTIVETREE_SEARCH);
+BENCHMARK(PREFIX_FROZENTREE_SEARCH);
 BENCHMARK(PREFIX_RBTREE_SEARCH);
 BENCHMARK(PREFIX_STLSET_SEARCH);
 
+/* BATCH SEARCH TESTS: shuffled words, one lookup after another vs interleaved lookups */
+
+static std::vector<std::string_view> ShuffledWords() {
+    std::vector<std::string_view> words(wap.begin(), wap.end());
+    std::shuffle(words.begin(), words.end(), std::mt19937(2));
+    return words;
+}
+static void PREFIX_PREFIXTREE_SEARCH_SHUFFLED(benchmark::State& state) {
+    const auto& tree = t.PrefixTree;
+    const auto words = ShuffledWords();
+    for(auto _ : state)
+        for(auto word: words)
+            if (!tree.Exists(std::string(word)))
+                std::cout << "BROKEN TREE ON WORD " << word << "\n";
+    state.SetLabel("Words=" + std::to_string(words.size()));
+}
+static void PREFIX_PREFIXTREE_SEARCH_BATCH(benchmark::State& state) {
+    const auto& tree = t.PrefixTree;
+    const auto words = ShuffledWords();
+    const size_t batch = state.range(0);
+    std::unique_ptr<bool[]> found(new bool[batch]);
+    for(auto _ : state)
+        for(size_t i=0; i<words.size(); i+=batch) {
+            const size_t n = std::min(batch, words.size() - i);
+            tree.ExistsBatch(std::span(words).subspan(i, n), std::span<bool>(found.get(), n));
+            if (std::count(found.get(), found.get() + n, true) != ptrdiff_t(n))
+                std::cout << "BROKEN BATCH AT " << i << "\n";
+        }
+    state.SetLabel("Words=" + std::to_string(words.size()));
+}
+
+BENCHMARK(PREFIX_PREFIXTREE_SEARCH_SHUFFLED);
+BENCHMARK(PREFIX_PREFIXTREE_SEARCH_BATCH)->Arg(1)->Arg(16)->Arg(256);
+
+/* LONGEST PREFIX TESTS: the longest word which is a prefix of two adjacent words glued together */
+
+static std::vector<std::string> GluedWords() {
+    std::vector<std::string> glued;
+    for(auto it=wap.begin(); it!=wap.end() && std::next(it)!=wap.end(); ++it)
+        glued.push_back(*it + *std::next(it));
+    return glued;
+}
+static void PREFIX_PREFIXTREE_LONGEST_PREFIX(benchmark::State& state) {
+    const auto& tree = t.PrefixTree;
+    const auto glued = GluedWords();
+    size_t total = 0;
+    for(auto _ : state)
+        for(const auto& x: glued)
+            total += tree.LongestPrefixOf(x).value_or(std::string_view()).size();
+    benchmark::DoNotOptimize(total);
+    state.SetLabel("Words=" + std::to_string(glued.size()));
+}
+static void PREFIX_PREFIXTREE_LONGEST_PREFIX_EXISTS(benchmark::State& state) {
+    const auto& tree = t.PrefixTree;
+    const auto glued = GluedWords();
+    size_t total = 0;
+    for(auto _ : state)
+        for(const auto& x: glued) {
+            size_t n = x.size(); // the empty word isn't there
+            while(n > 0 && !tree.Exists(x.substr(0, n)))
+                --n;
+            total += n;
+        }
+    benchmark::DoNotOptimize(total);
+    state.SetLabel("Words=" + std::to_string(glued.size()));
+}
+static void PREFIX_PREFIXTREE_ALL_PREFIXES(benchmark::State& state) {
+    const auto& tree = t.PrefixTree;
+    const auto glued = GluedWords();
+    size_t total = 0;
+    for(auto _ : state)
+        for(const auto& x: glued)
+            total += tree.AllPrefixesOf(x).size();
+    benchmark::DoNotOptimize(total);
+    state.SetLabel("Words=" + std::to_string(glued.size()));
+}
+
+BENCHMARK(PREFIX_PREFIXTREE_LONGEST_PREFIX);
+BENCHMARK(PREFIX_PREFIXTREE_LONGEST_PREFIX_EXISTS);
+BENCHMARK(PREFIX_PREFIXTREE_ALL_PREFIXES);
+
+/* FUZZY TESTS: words within an edit distance of misspelled ones, the tree vs a scan of the dictionary */
+
+static std::vector<std::string> Misspelled() {
+    std::vector<std::string> queries;
+    std::mt19937 rng(1);
+    size_t i = 0;
+    for(const auto& word: wap)
+        if (i++ % 2000 == 0) {
+            std::string q = word;
+            q[rng() % q.size()] = 'a' + rng() % 26;
+            queries.push_back(q);
+        }
+    return queries;
+}
+static ui32 Levenshtein(std::string_view a, std::string_view b) {
+    std::vector<ui32> row(b.size() + 1);
+    for(size_t j=0; j<=b.size(); ++j)
+        row[j] = j;
+    for(size_t i=1; i<=a.size(); ++i) {
+        ui32 diag = row[0];
+        row[0] = i;
+        for(size_t j=1; j<=b.size(); ++j) {
+            const ui32 up = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diag + (a[i - 1] != b[j - 1])});
+            diag = up;
+        }
+    }
+    return row.back();
+}
+static void PREFIX_PREFIXTREE_FUZZY(benchmark::State& state) {
+    const auto& tree = t.PrefixTree;
+    const auto queries = Misspelled();
+    size_t found = 0;
+    for(auto _ : state)
+        for(const auto& q: queries)
+            found += tree.FuzzySearch(q, state.range(0)).size();
+    benchmark::DoNotOptimize(found);
+    state.SetLabel("Queries=" + std::to_string(queries.size()));
+}
+static void PREFIX_SCAN_FUZZY(benchmark::State& state) {
+    const auto& set = t.StlSet;
+    const auto queries = Misspelled();
+    size_t found = 0;
+    for(auto _ : state)
+        for(const auto& q: queries)
+            for(const auto& word: set)
+                found += Levenshtein(word, q) <= state.range(0);
+    benchmark::DoNotOptimize(found);
+    state.SetLabel("Queries=" + std::to_string(queries.size()));
+}
+
+BENCHMARK(PREFIX_PREFIXTREE_FUZZY)->Arg(1)->Arg(2);
+BENCHMARK(PREFIX_SCAN_FUZZY)->Arg(1)->Arg(2);
+
+/* COUNT TESTS: word frequencies, a map vs a tree with a hash map of values next to it */
+
+static void PREFIX_PREFIXMAP_COUNT(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TMap<ui32> map;
+        for(const auto& word: wap)
+            map.Update(word, [](ui32& n) { ++n; });
+    }
+    state.SetItemsProcessed(state.iterations() * wap.size());
+}
+static void PREFIX_PREFIXTREE_HASHMAP_COUNT(benchmark::State& state) {
+    for(auto _ : state) {
+        NPrefix::TTree tree;
+        std::unordered_map<std::string, ui32> counts;
+        for(const auto& word: wap) {
+            tree.Append(word);
+            ++counts[word];
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * wap.size());
+}
+
+BENCHMARK(PREFIX_PREFIXMAP_COUNT);
+BENCHMARK(PREFIX_PREFIXTREE_HASHMAP_COUNT);
+
+/* ITERATE TESTS: all keys with a prefix of one letter, autocomplete-like */
+
+static void PREFIX_PREFIXTREE_ITERATE(benchmark::State& state) {
+    size_t keys = 0;
+    for(auto _ : state)
+        for(char c='a'; c<='z'; ++c)
+            for(auto it = t.PrefixTree.KeysWithPrefix(std::string(1, c)); it; ++it) {
+                benchmark::DoNotOptimize(it.Key());
+                ++keys;
+            }
+    state.SetItemsProcessed(keys);
+}
+static void PREFIX_PREFIXTREE_CURSOR(benchmark::State& state) {
+    size_t keys = 0;
+    NPrefix::TTree::TCursor cursor(t.PrefixTree);
+    for(auto _ : state)
+        for(char c='a'; c<='z'; ++c)
+            for(cursor.Seek(std::string_view(&c, 1)); cursor; ++cursor) {
+                benchmark::DoNotOptimize(cursor.Key());
+                ++keys;
+            }
+    state.SetItemsProcessed(keys);
+}
+static void PREFIX_PREFIXTREE_FOREACH(benchmark::State& state) {
+    size_t keys = 0;
+    for(auto _ : state)
+        for(char c='a'; c<='z'; ++c)
+            t.PrefixTree.ForEachWithPrefix(std::string_view(&c, 1), [&keys](std::string_view key) {
+                benchmark::DoNotOptimize(key);
+                ++keys;
+            });
+    state.SetItemsProcessed(keys);
+}
+
+BENCHMARK(PREFIX_PREFIXTREE_ITERATE);
+BENCHMARK(PREFIX_PREFIXTREE_CURSOR);
+BENCHMARK(PREFIX_PREFIXTREE_FOREACH);
+
+/* RANGE TESTS: seek to each word and scan the next 16 keys */
+
+constexpr ui32 RangeScan = 16;
+
+static void PREFIX_PREFIXTREE_RANGE(benchmark::State& state) {
+    NPrefix::TTree::TCursor cursor(t.PrefixTree);
+    for(auto _ : state)
+        for(const auto& word: wap) {
+            cursor.SeekLowerBound(word);
+            for(ui32 i=0; i<RangeScan && cursor; ++i, ++cursor)
+                benchmark::DoNotOptimize(cursor.Key());
+        }
+    state.SetItemsProcessed(state.iterations() * wap.size());
+}
+static void PREFIX_STLSET_RANGE(benchmark::State& state) {
+    const auto& set = t.StlSet;
+    for(auto _ : state)
+        for(const auto& word: wap) {
+            auto it = set.lower_bound(word);
+            for(ui32 i=0; i<RangeScan && it != set.end(); ++i, ++it)
+                benchmark::DoNotOptimize(*it);
+        }
+    state.SetItemsProcessed(state.iterations() * wap.size());
+}
+
+BENCHMARK(PREFIX_PREFIXTREE_RANGE);
+BENCHMARK(PREFIX_STLSET_RANGE);
+
+/* CONCURRENT TESTS: each thread looks words up, thread 0 also appends/removes one word per 64 lookups */
+
+constexpr ui32 MixedLookups = 1 << 12;
+constexpr ui32 MixedWriteEach = 64;
+static const std::vector<std::string> MixedWords(wap.begin(), wap.begin() + std::min<size_t>(wap.size(), 1 << 16));
+
+/* the object shared by the threads of one run: the first thread builds it, the last one frees it
+ * (the threads of the previous run are joined by then, so it's a new object for each run)
+ */
+template<typename TShared>
+static std::shared_ptr<TShared> SharedInRun() {
+    static std::mutex lock;
+    static std::weak_ptr<TShared> current;
+    std::lock_guard guard(lock);
+    std::shared_ptr<TShared> shared = current.lock();
+    if (!shared) {
+        shared = std::make_shared<TShared>();
+        for(const auto& word: MixedWords)
+            shared->Append(word);
+        current = shared;
+    }
+    return shared;
+}
+static void PREFIX_CONCURRENTTREE_MIXED(benchmark::State& state) {
+    const auto tree = SharedInRun<NPrefix::TConcurrentTree>();
+    NPrefix::TConcurrentTree::TReader reader(*tree); // destroyed before the tree
+    size_t i = state.thread_index * 7919, w = 0;
+    for(auto _ : state)
+        for(ui32 j=0; j<MixedLookups; ++j, ++i) {
+            benchmark::DoNotOptimize(reader.Exists(MixedWords[i % MixedWords.size()]));
+            if (state.thread_index == 0 && j % MixedWriteEach == 0) {
+                const std::string word = MixedWords[w++ % MixedWords.size()] + "~";
+                if (!tree->Append(word))
+                    tree->Remove(word);
+            }
+        }
+    state.SetItemsProcessed(state.iterations() * MixedLookups);
+}
+
+static std::shared_mutex SharedTreeLock;
+static void PREFIX_PREFIXTREE_RWLOCK_MIXED(benchmark::State& state) {
+    const auto tree = SharedInRun<NPrefix::TTree>();
+    size_t i = state.thread_index * 7919, w = 0;
+    for(auto _ : state)
+        for(ui32 j=0; j<MixedLookups; ++j, ++i) {
+            {
+                std::shared_lock lock(SharedTreeLock);
+                benchmark::DoNotOptimize(tree->Exists(MixedWords[i % MixedWords.size()]));
+            }
+            if (state.thread_index == 0 && j % MixedWriteEach == 0) {
+                const std::string word = MixedWords[w++ % MixedWords.size()] + "~";
+                std::unique_lock lock(SharedTreeLock);
+                if (!tree->Append(word))
+                    tree->Remove(word);
+            }
+        }
+    state.SetItemsProcessed(state.iterations() * MixedLookups);
+}
+
+BENCHMARK(PREFIX_CONCURRENTTREE_MIXED)->ThreadRange(1, MaxThreads)->UseRealTime();
+BENCHMARK(PREFIX_PREFIXTREE_RWLOCK_MIXED)->ThreadRange(1, MaxThreads)->UseRealTime();
+
+/* PAGE SIZE TESTS: nodes from 4K heap blocks vs huge page blocks, random lookups */
+
+template<typename TPoolType, size_t BlockSize>
+static void PREFIX_PREFIXTREE_PAGES_SEARCH(benchmark::State& state) {
+    NMemory::TPoolResource<TPoolType> arena(BlockSize);
+    NPrefix::NPmr::TTree tree(&arena);
+    std::vector<std::string> words(wap.begin(), wap.end());
+    for(const auto& word: words)
+        tree.Append(word);
+    std::shuffle(words.begin(), words.end(), std::mt19937(42));
+
+    for(auto _ : state)
+        for(const auto& word: words)
+            if (!tree.Exists(word))
+                std::cout << "BROKEN TREE ON WORD " << word << "\n";
+    state.SetItemsProcessed(state.iterations() * words.size());
+    ReportStats(state, arena.Stats());
+    state.SetLabel("Words=" + std::to_string(wap.size())
+                 + ",Blocks=" + std::to_string(arena.Pool().BlocksCount()));
+}
+
+BENCHMARK_TEMPLATE(PREFIX_PREFIXTREE_PAGES_SEARCH, NMemory::TPool<NMemory::TLinearStrategy>, 4096);
+BENCHMARK_TEMPLATE(PREFIX_PREFIXTREE_PAGES_SEARCH,
+                   NMemory::TPool<NMemory::TLinearStrategy, NMemory::TMmapBlockSource<>>, 2 << 20);
+
 /*
+ * *_ARENA and *_PAGES_* benchmarks report the arena statistics as counters
+ * (Requested/Reserved/Peak/TailWaste/Allocs), the table below is for the rest
  * Separate memory consumption benchmark shows:
  * // count(uniq(keys)) = 27185, count(keys) = 565622
  *
@@ -1,14 +1,57 @@
 #include "avl.h"
+#include "mmapsource.h"
 #include "rbset.h"
+#include "slab.h"
 #include "vanemdeboas.h"
 
+#include <algorithm>
+#include <numeric>
+#include <random>
 #include <set>
 #include <unordered_set>
 #include <benchmark/benchmark.h>
+#include "b_stats.h"
 
 constexpr ui32 N = 10000;
 
-// there was tests for insert - but, allegedly, it's the allocator's wars
+/* INSERT/ERASE TESTS - the allocator's wars */
+
+template<typename TAllocator>
+static void NUMBERS_RBTREE_INSERT(benchmark::State& state) {
+    for(auto _ : state) {
+        NRBTree::TSet<ui32, TAllocator> set;
+        for(ui32 i=0; i<N; ++i)
+            set.insert(i);
+    }
+    state.SetItemsProcessed(state.iterations() * N);
+    if constexpr (requires { TAllocator::Stats(); })
+        ReportStats(state, TAllocator::Stats());
+}
+template<typename TAllocator>
+static void NUMBERS_RBTREE_CHURN(benchmark::State& state) {
+    NRBTree::TSet<ui32, TAllocator> set;
+    for(ui32 i=0; i<N; ++i)
+        set.insert(i);
+    // sliding window [lo, lo+N): the oldest key leaves, a new one comes
+    ui32 lo = 0;
+    for(auto _ : state) {
+        for(ui32 i=0; i<N; ++i, ++lo) {
+            set.erase(lo);
+            set.insert(lo + N);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * N);
+    if constexpr (requires { TAllocator::Stats(); })
+        ReportStats(state, TAllocator::Stats());
+    state.SetLabel("Size="+std::to_string(set.size()));
+}
+
+BENCHMARK_TEMPLATE(NUMBERS_RBTREE_INSERT, NRBTree::TDefaultAllocator);
+BENCHMARK_TEMPLATE(NUMBERS_RBTREE_INSERT, NMemory::TSlabAllocator<>);
+BENCHMARK_TEMPLATE(NUMBERS_RBTREE_CHURN, NRBTree::TDefaultAllocator);
+BENCHMARK_TEMPLATE(NUMBERS_RBTREE_CHURN, NMemory::TSlabAllocator<>);
+
+/* SEARCH TESTS */
 
 static void NUMBERS_RBTREE_SEARCH(benchmark::State& state) {
     //setup
@@ -91,4 +134,41 @@ BENCHMARK(NUMBERS_STL_HASH_SEARCH);
 BENCHMARK(NUMBERS_RBTREE_SEARCH);
 BENCHMARK(NUMBERS_RBTREE_SELECT);
 BENCHMARK(NUMBERS_AVL_SET_SEARCH);
-BENCHMARK(NUMBERS_VANEMDEBOAS_SEARCH);
\ No newline at end of file
+BENCHMARK(NUMBERS_VANEMDEBOAS_SEARCH);
+
+/* PAGE SIZE TESTS: nodes from 4K heap blocks vs huge page blocks, random lookups */
+
+template<typename TPoolType, size_t BlockSize>
+struct TBlockSlab : public NMemory::TSlab<TPoolType> {
+    TBlockSlab()
+        : NMemory::TSlab<TPoolType>(BlockSize)
+    {}
+};
+using T4KSlab = TBlockSlab<NMemory::TPool<NMemory::TLinearStrategy>, 4096>;
+using THugeSlab = TBlockSlab<NMemory::TPool<NMemory::TLinearStrategy, NMemory::TMmapBlockSource<>>, 2 << 20>;
+
+template<typename TSlabType>
+static void NUMBERS_RBTREE_BIG_SEARCH(benchmark::State& state) {
+    constexpr ui32 BigN = 1 << 20;
+    std::vector<ui32> keys(BigN);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::mt19937 rng(42);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    NRBTree::TSet<ui32, NMemory::TSlabAllocator<TSlabType>> set;
+    for(ui32 k: keys)
+        set.insert(k);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    for(auto _ : state)
+        for(ui32 k: keys)
+            if (!set.exists(k))
+                std::cout << "BROKEN ON " << k << '\n';
+    state.SetItemsProcessed(state.iterations() * BigN);
+    ReportStats(state, NMemory::TSlabAllocator<TSlabType>::Stats());
+    state.SetLabel("Size="+std::to_string(set.size())
+                 +",Blocks="+std::to_string(NMemory::TSlabAllocator<TSlabType>::Local().BlocksCount()));
+}
+
+BENCHMARK_TEMPLATE(NUMBERS_RBTREE_BIG_SEARCH, T4KSlab);
+BENCHMARK_TEMPLATE(NUMBERS_RBTREE_BIG_SEARCH, THugeSlab);
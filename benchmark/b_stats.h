@@ -0,0 +1,14 @@
+#pragma once
+
+#include "mempool.h"
+#include <benchmark/benchmark.h>
+
+/* memory cost next to speed: NMemory::TStats as benchmark counters */
+inline void ReportStats(benchmark::State& state, const NMemory::TStats& s) {
+    using benchmark::Counter;
+    state.counters["Requested"] = Counter(s.Requested, Counter::kDefaults, Counter::kIs1024);
+    state.counters["Reserved"]  = Counter(s.Reserved, Counter::kDefaults, Counter::kIs1024);
+    state.counters["Peak"]      = Counter(s.Peak, Counter::kDefaults, Counter::kIs1024);
+    state.counters["TailWaste"] = Counter(s.TailWaste, Counter::kDefaults, Counter::kIs1024);
+    state.counters["Allocs"]    = Counter(s.Allocations);
+}
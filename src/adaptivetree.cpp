@@ -0,0 +1,447 @@
+#include "adaptivetree.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace NPrefix {
+    TAdaptiveTree::TLeaf* TAdaptiveTree::NewLeaf(std::string_view key) {
+        TLeaf* leaf = static_cast<TLeaf*>(::operator new(sizeof(TLeaf) + key.size()));
+        leaf->Size = key.size();
+        std::memcpy(leaf + 1, key.data(), key.size());
+        return leaf;
+    }
+    void TAdaptiveTree::DeleteLeaf(TLeaf* leaf) noexcept {
+        ::operator delete(leaf);
+    }
+    void TAdaptiveTree::DeleteNode(TNode* node) noexcept {
+        switch(node->Type) {
+            case NODE4:   delete static_cast<TNode4*>(node); break;
+            case NODE16:  delete static_cast<TNode16*>(node); break;
+            case NODE48:  delete static_cast<TNode48*>(node); break;
+            case NODE256: delete static_cast<TNode256*>(node); break;
+        }
+    }
+    void TAdaptiveTree::SetPrefix(TNode* node, std::string_view key, size_t from, ui32 len) noexcept {
+        node->PrefixLen = len;
+        for(ui32 i=0; i<std::min(len, MaxPrefix); ++i)
+            node->Prefix[i] = At(key, from + i);
+    }
+
+    TAdaptiveTree::TRef* TAdaptiveTree::FindChild(TNode* node, const ui8 byte) noexcept {
+        switch(node->Type) {
+            case NODE4: {
+                auto* n = static_cast<TNode4*>(node);
+                for(ui32 i=0; i<n->Count; ++i)
+                    if (n->Keys[i] == byte)
+                        return &n->Children[i];
+                return nullptr;
+            }
+            case NODE16: {
+                auto* n = static_cast<TNode16*>(node);
+#ifdef __SSE2__
+                __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(byte), _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->Keys)));
+                ui32 mask = _mm_movemask_epi8(cmp) & ((1U << n->Count) - 1);
+                return mask ? &n->Children[__builtin_ctz(mask)] : nullptr;
+#else
+                for(ui32 i=0; i<n->Count; ++i)
+                    if (n->Keys[i] == byte)
+                        return &n->Children[i];
+                return nullptr;
+#endif
+            }
+            case NODE48: {
+                auto* n = static_cast<TNode48*>(node);
+                return n->Index[byte] ? &n->Children[n->Index[byte] - 1] : nullptr;
+            }
+            case NODE256: {
+                auto* n = static_cast<TNode256*>(node);
+                return n->Children[byte] ? &n->Children[byte] : nullptr;
+            }
+        }
+        return nullptr;
+    }
+    // children in the byte order, 0 after the last one
+    TAdaptiveTree::TRef TAdaptiveTree::Child(const TNode* node, ui32& pos) noexcept {
+        switch(node->Type) {
+            case NODE4: {
+                auto* n = static_cast<const TNode4*>(node);
+                return pos < n->Count ? n->Children[pos++] : 0;
+            }
+            case NODE16: {
+                auto* n = static_cast<const TNode16*>(node);
+                return pos < n->Count ? n->Children[pos++] : 0;
+            }
+            case NODE48: {
+                auto* n = static_cast<const TNode48*>(node);
+                for(; pos < 256; ++pos)
+                    if (n->Index[pos])
+                        return n->Children[n->Index[pos++] - 1];
+                return 0;
+            }
+            case NODE256: {
+                auto* n = static_cast<const TNode256*>(node);
+                for(; pos < 256; ++pos)
+                    if (n->Children[pos])
+                        return n->Children[pos++];
+                return 0;
+            }
+        }
+        return 0;
+    }
+    const TAdaptiveTree::TLeaf* TAdaptiveTree::Minimum(TRef r) noexcept {
+        while(!IsLeaf(r)) {
+            ui32 pos = 0;
+            r = Child(AsNode(r), pos);
+        }
+        return AsLeaf(r);
+    }
+    // the length of the common part of the node prefix and key[depth..]
+    ui32 TAdaptiveTree::PrefixMismatch(TRef r, std::string_view key, size_t depth) noexcept {
+        const TNode* node = AsNode(r);
+        ui32 inlined = std::min(node->PrefixLen, MaxPrefix);
+        for(ui32 i=0; i<inlined; ++i)
+            if (node->Prefix[i] != At(key, depth + i))
+                return i;
+        if (node->PrefixLen > MaxPrefix) {
+            std::string_view min = Key(Minimum(r));
+            for(ui32 i=inlined; i<node->PrefixLen; ++i)
+                if (At(min, depth + i) != At(key, depth + i))
+                    return i;
+        }
+        return node->PrefixLen;
+    }
+
+    template<typename TTo, typename TFrom>
+    static TTo* Convert(TFrom* from) {
+        TTo* to = new TTo();
+        to->Count = from->Count;
+        to->PrefixLen = from->PrefixLen;
+        std::memcpy(to->Prefix, from->Prefix, sizeof(from->Prefix));
+        return to;
+    }
+
+    // the node in 'ref' may be replaced by a bigger one
+    void TAdaptiveTree::AddChild(TRef& ref, const ui8 byte, const TRef child) {
+        TNode* node = AsNode(ref);
+        auto insertSorted = [byte, child](auto* n) {
+            ui32 pos = 0;
+            while(pos < n->Count && n->Keys[pos] < byte)
+                ++pos;
+            std::memmove(n->Keys + pos + 1, n->Keys + pos, n->Count - pos);
+            std::memmove(n->Children + pos + 1, n->Children + pos, (n->Count - pos) * sizeof(TRef));
+            n->Keys[pos] = byte;
+            n->Children[pos] = child;
+            ++n->Count;
+        };
+        switch(node->Type) {
+            case NODE4: {
+                auto* n = static_cast<TNode4*>(node);
+                if (n->Count < 4)
+                    return insertSorted(n);
+                TNode16* g = Convert<TNode16>(n);
+                std::memcpy(g->Keys, n->Keys, sizeof(n->Keys));
+                std::memcpy(g->Children, n->Children, sizeof(n->Children));
+                delete n;
+                ref = Ref(g);
+                return insertSorted(g);
+            }
+            case NODE16: {
+                auto* n = static_cast<TNode16*>(node);
+                if (n->Count < 16)
+                    return insertSorted(n);
+                TNode48* g = Convert<TNode48>(n);
+                for(ui32 i=0; i<n->Count; ++i) {
+                    g->Index[n->Keys[i]] = i + 1;
+                    g->Children[i] = n->Children[i];
+                }
+                delete n;
+                ref = Ref(g);
+                return AddChild(ref, byte, child);
+            }
+            case NODE48: {
+                auto* n = static_cast<TNode48*>(node);
+                if (n->Count < 48) {
+                    ui32 slot = 0;
+                    while(n->Children[slot])
+                        ++slot;
+                    n->Children[slot] = child;
+                    n->Index[byte] = slot + 1;
+                    ++n->Count;
+                    return;
+                }
+                TNode256* g = Convert<TNode256>(n);
+                for(ui32 b=0; b<256; ++b)
+                    if (n->Index[b])
+                        g->Children[b] = n->Children[n->Index[b] - 1];
+                delete n;
+                ref = Ref(g);
+                return AddChild(ref, byte, child);
+            }
+            case NODE256: {
+                auto* n = static_cast<TNode256*>(node);
+                n->Children[byte] = child;
+                ++n->Count;
+                return;
+            }
+        }
+    }
+    // the node in 'ref' may be replaced by a smaller one, Node4 with the only child by the child
+    void TAdaptiveTree::RemoveChild(TRef& ref, const ui8 byte) noexcept {
+        TNode* node = AsNode(ref);
+        auto eraseSorted = [byte](auto* n) {
+            ui32 pos = 0;
+            while(n->Keys[pos] != byte)
+                ++pos;
+            std::memmove(n->Keys + pos, n->Keys + pos + 1, n->Count - pos - 1);
+            std::memmove(n->Children + pos, n->Children + pos + 1, (n->Count - pos - 1) * sizeof(TRef));
+            --n->Count;
+        };
+        switch(node->Type) {
+            case NODE4: {
+                auto* n = static_cast<TNode4*>(node);
+                eraseSorted(n);
+                if (n->Count != 1)
+                    return;
+                TRef child = n->Children[0];
+                if (!IsLeaf(child)) {
+                    // the child prefix becomes: node prefix + key byte + child prefix
+                    TNode* c = AsNode(child);
+                    ui8 prefix[MaxPrefix];
+                    ui32 len = std::min(n->PrefixLen, MaxPrefix);
+                    std::memcpy(prefix, n->Prefix, len);
+                    if (len < MaxPrefix)
+                        prefix[len++] = n->Keys[0];
+                    ui32 tail = std::min(std::min(c->PrefixLen, MaxPrefix), MaxPrefix - len);
+                    std::memcpy(prefix + len, c->Prefix, tail);
+                    std::memcpy(c->Prefix, prefix, len + tail);
+                    c->PrefixLen += n->PrefixLen + 1;
+                }
+                delete n;
+                ref = child;
+                return;
+            }
+            case NODE16: {
+                auto* n = static_cast<TNode16*>(node);
+                eraseSorted(n);
+                if (n->Count != 3)
+                    return;
+                TNode4* s = Convert<TNode4>(n);
+                std::memcpy(s->Keys, n->Keys, 3);
+                std::memcpy(s->Children, n->Children, 3 * sizeof(TRef));
+                delete n;
+                ref = Ref(s);
+                return;
+            }
+            case NODE48: {
+                auto* n = static_cast<TNode48*>(node);
+                n->Children[n->Index[byte] - 1] = 0;
+                n->Index[byte] = 0;
+                if (--n->Count != 12)
+                    return;
+                TNode16* s = Convert<TNode16>(n);
+                ui32 i = 0;
+                for(ui32 b=0; b<256; ++b)
+                    if (n->Index[b]) {
+                        s->Keys[i] = b;
+                        s->Children[i++] = n->Children[n->Index[b] - 1];
+                    }
+                delete n;
+                ref = Ref(s);
+                return;
+            }
+            case NODE256: {
+                auto* n = static_cast<TNode256*>(node);
+                n->Children[byte] = 0;
+                if (--n->Count != 37)
+                    return;
+                TNode48* s = Convert<TNode48>(n);
+                ui32 slot = 0;
+                for(ui32 b=0; b<256; ++b)
+                    if (n->Children[b]) {
+                        s->Children[slot] = n->Children[b];
+                        s->Index[b] = ++slot;
+                    }
+                delete n;
+                ref = Ref(s);
+                return;
+            }
+        }
+    }
+
+    bool TAdaptiveTree::Append(std::string_view key) {
+        TRef* ref = &Root;
+        size_t depth = 0;
+        while(true) {
+            if (!*ref) {
+                *ref = Ref(NewLeaf(key));
+                ++Size; return true;
+            }
+            if (IsLeaf(*ref)) {
+                std::string_view other = Key(AsLeaf(*ref));
+                if (other == key)
+                    return false;
+                // the leaf becomes a Node4 with the common part as the prefix
+                size_t i = depth;
+                while(At(other, i) == At(key, i))
+                    ++i;
+                TLeaf* leaf = NewLeaf(key);
+                TRef split = Ref(new TNode4());
+                SetPrefix(AsNode(split), key, depth, i - depth);
+                AddChild(split, At(other, i), *ref);
+                AddChild(split, At(key, i), Ref(leaf));
+                *ref = split;
+                ++Size; return true;
+            }
+            TNode* node = AsNode(*ref);
+            if (node->PrefixLen) {
+                ui32 m = PrefixMismatch(*ref, key, depth);
+                if (m < node->PrefixLen) {
+                    // a new Node4 takes the common part of the prefix
+                    TLeaf* leaf = NewLeaf(key);
+                    TRef split = Ref(new TNode4());
+                    SetPrefix(AsNode(split), key, depth, m);
+                    ui8 byte;
+                    if (node->PrefixLen <= MaxPrefix) {
+                        byte = node->Prefix[m];
+                        node->PrefixLen -= m + 1;
+                        std::memmove(node->Prefix, node->Prefix + m + 1, node->PrefixLen);
+                    } else {
+                        std::string_view min = Key(Minimum(*ref));
+                        byte = At(min, depth + m);
+                        SetPrefix(node, min, depth + m + 1, node->PrefixLen - m - 1);
+                    }
+                    AddChild(split, byte, *ref);
+                    AddChild(split, At(key, depth + m), Ref(leaf));
+                    *ref = split;
+                    ++Size; return true;
+                }
+                depth += node->PrefixLen;
+            }
+            if (TRef* child = FindChild(node, At(key, depth))) {
+                ref = child; ++depth;
+                continue;
+            }
+            TLeaf* leaf = NewLeaf(key);
+            AddChild(*ref, At(key, depth), Ref(leaf));
+            ++Size; return true;
+        }
+    }
+    bool TAdaptiveTree::Exists(std::string_view key) const noexcept {
+        TRef r = Root;
+        size_t depth = 0;
+        while(r) {
+            if (IsLeaf(r))
+                return Key(AsLeaf(r)) == key;
+            TNode* node = AsNode(r);
+            if (node->PrefixLen) {
+                for(ui32 i=0; i<std::min(node->PrefixLen, MaxPrefix); ++i)
+                    if (node->Prefix[i] != At(key, depth + i))
+                        return false;
+                depth += node->PrefixLen; // the rest is checked by the leaf
+                if (depth > key.size())
+                    return false;
+            }
+            TRef* child = FindChild(node, At(key, depth));
+            if (!child)
+                return false;
+            r = *child; ++depth;
+        }
+        return false;
+    }
+    bool TAdaptiveTree::Remove(std::string_view key) {
+        TRef* ref = &Root;
+        TRef* parent = nullptr;
+        ui8 parentByte = 0;
+        size_t depth = 0;
+        while(*ref) {
+            if (IsLeaf(*ref)) {
+                if (Key(AsLeaf(*ref)) != key)
+                    return false;
+                DeleteLeaf(AsLeaf(*ref));
+                if (parent)
+                    RemoveChild(*parent, parentByte);
+                else
+                    Root = 0;
+                --Size; return true;
+            }
+            TNode* node = AsNode(*ref);
+            if (node->PrefixLen) {
+                for(ui32 i=0; i<std::min(node->PrefixLen, MaxPrefix); ++i)
+                    if (node->Prefix[i] != At(key, depth + i))
+                        return false;
+                depth += node->PrefixLen;
+                if (depth > key.size())
+                    return false;
+            }
+            TRef* child = FindChild(node, At(key, depth));
+            if (!child)
+                return false;
+            parent = ref; parentByte = At(key, depth);
+            ref = child; ++depth;
+        }
+        return false;
+    }
+    // the subtree with all keys starting with 'prefix', or 0
+    TAdaptiveTree::TRef TAdaptiveTree::Seek(std::string_view prefix) const noexcept {
+        TRef r = Root;
+        size_t depth = 0;
+        while(r && !IsLeaf(r) && depth < prefix.size()) {
+            TNode* node = AsNode(r);
+            for(ui32 i=0; i<std::min(node->PrefixLen, MaxPrefix) && depth + i < prefix.size(); ++i)
+                if (node->Prefix[i] != ui8(prefix[depth + i]))
+                    return 0;
+            depth += node->PrefixLen;
+            if (depth >= prefix.size())
+                break;
+            TRef* child = FindChild(node, prefix[depth]);
+            r = child ? *child : 0;
+            ++depth;
+        }
+        if (!r || !Key(Minimum(r)).starts_with(prefix)) // skipped bytes of the prefixes are checked here
+            return 0;
+        return r;
+    }
+    void TAdaptiveTree::clear() noexcept {
+        std::vector<TRef> todo;
+        if (Root)
+            todo.push_back(Root);
+        while(!todo.empty()) {
+            TRef r = todo.back(); todo.pop_back();
+            if (IsLeaf(r)) {
+                DeleteLeaf(AsLeaf(r));
+                continue;
+            }
+            ui32 pos = 0;
+            while(TRef c = Child(AsNode(r), pos))
+                todo.push_back(c);
+            DeleteNode(AsNode(r));
+        }
+        Root = 0; Size = 0;
+    }
+
+    TAdaptiveTree::TIterator::TIterator(TRef r) {
+        if (r)
+            Descend(r);
+    }
+    void TAdaptiveTree::TIterator::Descend(TRef r) {
+        while(!IsLeaf(r)) {
+            S.push_back({AsNode(r), 0});
+            r = Child(S.back().Node, S.back().Pos);
+        }
+        Cur = AsLeaf(r);
+    }
+    TAdaptiveTree::TIterator& TAdaptiveTree::TIterator::operator ++() {
+        Cur = nullptr;
+        while(!S.empty()) {
+            if (TRef r = Child(S.back().Node, S.back().Pos)) {
+                Descend(r);
+                break;
+            }
+            S.pop_back();
+        }
+        return *this;
+    }
+}
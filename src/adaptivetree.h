@@ -0,0 +1,138 @@
+#pragma once
+
+/*
+ *  Adaptive radix tree (ART): a prefix tree with the node kind picked by fan-out
+ *  1. Inner nodes are Node4/Node16 (sorted bytes, Node16 is searched with SSE2),
+ *     Node48 (256 byte index into 48 children) and Node256 (direct array):
+ *     child lookup and insert are O(1), sparse nodes stay small
+ *  2. Nodes grow and shrink between the kinds on Append/Remove
+ *  3. Path compression: an inner node keeps the length of the common part of its keys and
+ *     its first MaxPrefix bytes, the rest is checked against a leaf (optimistic search)
+ *  4. Leaves keep whole keys, children are tagged pointers (the low bit marks a leaf)
+ * P.S. Keys must not contain '\0', it's the implicit terminator (like in NPrefix::TTree)
+ * P.P.S. The interface is the one of NPrefix::TTree, keys are visited in the std::string order
+ *   TAdaptiveTree tree;
+ *   tree.Append("abc");
+ *   tree.Exists("bcd");
+ *   tree.Remove("abc");
+ *   for(auto it=tree.KeysWithPrefix("ab");it;++it)
+ *       std::cout << it.Key() << '\n';
+ */
+
+#include "defines.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace NPrefix {
+    class TAdaptiveTree {
+    private:
+        static constexpr ui32 MaxPrefix = 8;
+        enum EType : ui8 {
+            NODE4,
+            NODE16,
+            NODE48,
+            NODE256
+        };
+        using TRef = uintptr_t; // TNode* or TLeaf* | 1, 0 is empty
+
+        struct TNode {
+            EType Type;
+            ui16 Count = 0;
+            ui32 PrefixLen = 0;
+            ui8 Prefix[MaxPrefix];
+
+            TNode(EType type)
+                : Type(type)
+            {}
+        };
+        struct TNode4 : TNode {
+            ui8 Keys[4];
+            TRef Children[4];
+            TNode4() : TNode(NODE4) {}
+        };
+        struct TNode16 : TNode {
+            ui8 Keys[16];
+            TRef Children[16];
+            TNode16() : TNode(NODE16) {}
+        };
+        struct TNode48 : TNode {
+            ui8 Index[256] = {}; // slot + 1, 0 is empty
+            TRef Children[48] = {};
+            TNode48() : TNode(NODE48) {}
+        };
+        struct TNode256 : TNode {
+            TRef Children[256] = {};
+            TNode256() : TNode(NODE256) {}
+        };
+        // the key bytes follow the header
+        struct TLeaf {
+            ui32 Size;
+        };
+
+        TRef Root = 0;
+        ui32 Size = 0;
+    private:
+        static bool IsLeaf(const TRef r) noexcept { return r & 1; }
+        static TNode* AsNode(const TRef r) noexcept { return reinterpret_cast<TNode*>(r); }
+        static TLeaf* AsLeaf(const TRef r) noexcept { return reinterpret_cast<TLeaf*>(r & ~TRef(1)); }
+        static TRef Ref(const TNode* n) noexcept { return reinterpret_cast<TRef>(n); }
+        static TRef Ref(const TLeaf* l) noexcept { return reinterpret_cast<TRef>(l) | 1; }
+        static std::string_view Key(const TLeaf* l) noexcept {
+            return {reinterpret_cast<const char*>(l + 1), l->Size};
+        }
+        // the key with the implicit '\0' in the end
+        static ui8 At(const std::string_view s, const size_t i) noexcept {
+            return i < s.size() ? s[i] : 0;
+        }
+
+        static TLeaf* NewLeaf(std::string_view key);
+        static void DeleteLeaf(TLeaf* leaf) noexcept;
+        static void DeleteNode(TNode* node) noexcept;
+        static void SetPrefix(TNode* node, std::string_view key, size_t from, ui32 len) noexcept;
+        static TRef* FindChild(TNode* node, ui8 byte) noexcept;
+        static TRef Child(const TNode* node, ui32& pos) noexcept;
+        static const TLeaf* Minimum(TRef r) noexcept;
+        static ui32 PrefixMismatch(TRef r, std::string_view key, size_t depth) noexcept;
+        static void AddChild(TRef& ref, ui8 byte, TRef child);
+        static void RemoveChild(TRef& ref, ui8 byte) noexcept;
+        TRef Seek(std::string_view prefix) const noexcept;
+    public:
+        class TIterator {
+        private:
+            struct TFrame {
+                const TNode* Node;
+                ui32 Pos; // the next child: an index in Node4/16, a byte in Node48/256
+            };
+            std::vector<TFrame> S;
+            const TLeaf* Cur = nullptr;
+        private:
+            void Descend(TRef r);
+        public:
+            TIterator() {}
+            TIterator(TRef r);
+            std::string Key() const { return std::string(TAdaptiveTree::Key(Cur)); }
+            operator bool() const noexcept { return Cur != nullptr; }
+            TIterator& operator ++();
+        };
+    public:
+        TAdaptiveTree() {}
+        TAdaptiveTree(const TAdaptiveTree&) = delete;
+        TAdaptiveTree& operator=(const TAdaptiveTree&) = delete;
+        ~TAdaptiveTree() {
+            clear();
+        }
+        bool Append(std::string_view key);
+        bool Exists(std::string_view key) const noexcept;
+        bool Remove(std::string_view key);
+        TIterator KeysWithPrefix(std::string_view prefix) const {
+            return TIterator(Seek(prefix));
+        }
+        TIterator AllKeys() const {
+            return TIterator(Root);
+        }
+        void clear() noexcept;
+        ui32 size() const noexcept { return Size; }
+    };
+}
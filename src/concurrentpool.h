@@ -0,0 +1,142 @@
+#pragma once
+
+/*
+ * Thread-sharded arena: each thread bump allocates from its own shard,
+ * shards take fixed-size blocks from a shared lock-free cache
+ *  1. The cache is a Treiber stack of free blocks. Blocks are pushed back only by Reset(),
+ *     which must not run concurrently with allocations, so concurrent pops are ABA-free
+ *     (Reserve() pushes only new blocks, it may run concurrently)
+ *  2. When the cache is empty a shard allocates a new block from TBlockSource and publishes
+ *     it in the lock-free list of all blocks (push only)
+ *  3. Everything is freed at once by ~TConcurrentPool(), Reset() keeps the blocks for the next build
+ *
+ *   NMemory::TConcurrentPool<> pool;
+ *   // in each thread
+ *   NMemory::TConcurrentPool<>::TShard shard(pool);
+ *   T* x = shard.Emplace<T>(...);
+ *
+ * P.S. destructors aren't called here: the arena is for trivially destructible nodes
+ */
+
+#include "mempool.h"
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+
+namespace NMemory {
+    template<typename TBlockSource = THeapBlockSource>
+    class TConcurrentPool {
+    private:
+        static constexpr size_t DefaultBlockSize = 1 << 16;
+        // the header lives at the beginning of each block
+        struct TBlock {
+            TBlock* NextFree; // in the cache
+            TBlock* NextAll;  // in the list of all blocks
+            size_t Size;
+        };
+        static constexpr size_t HeaderSize = (sizeof(TBlock) + alignof(std::max_align_t) - 1)
+                                           & ~(alignof(std::max_align_t) - 1);
+
+        const size_t BlockSize;
+        std::atomic<TBlock*> Free{nullptr};
+        std::atomic<TBlock*> All{nullptr};
+        std::atomic<size_t> Count{0};
+    private:
+        TBlock* Pop() noexcept {
+            TBlock* b = Free.load(std::memory_order_acquire);
+            while(b && !Free.compare_exchange_weak(b, b->NextFree, std::memory_order_acquire))
+                ;
+            return b;
+        }
+        TBlock* NewBlock() {
+            size_t size = BlockSize;
+            char* ptr = TBlockSource::Allocate(size);
+            TBlock* b = new (ptr) TBlock{nullptr, All.load(std::memory_order_relaxed), size};
+            while(!All.compare_exchange_weak(b->NextAll, b, std::memory_order_release))
+                ;
+            Count.fetch_add(1, std::memory_order_relaxed);
+            return b;
+        }
+        TBlock* GetBlock() {
+            if (TBlock* b = Pop())
+                return b;
+            return NewBlock();
+        }
+    public:
+        class TShard {
+        private:
+            TConcurrentPool& P;
+            char* Cur = nullptr;
+            char* End = nullptr;
+        private:
+            void Grow() {
+                TBlock* b = P.GetBlock();
+                Cur = reinterpret_cast<char*>(b) + HeaderSize;
+                End = reinterpret_cast<char*>(b) + b->Size;
+            }
+        public:
+            TShard(TConcurrentPool& pool)
+                : P(pool)
+            {}
+            TShard(const TShard&) = delete;
+            TShard& operator=(const TShard&) = delete;
+
+            /* 'align' must be a power of two */
+            void* Allocate(const size_t size, const size_t align = alignof(std::max_align_t)) {
+                uintptr_t ptr = (reinterpret_cast<uintptr_t>(Cur) + align - 1) & ~(align - 1);
+                if (!Cur || ptr > reinterpret_cast<uintptr_t>(End) || size > reinterpret_cast<uintptr_t>(End) - ptr) {
+                    if (size > P.BlockSize - HeaderSize || align > P.BlockSize - HeaderSize - size)
+                        throw std::runtime_error("TConcurrentPool: Block size is not enough to store at least 1 element");
+                    Grow();
+                    ptr = (reinterpret_cast<uintptr_t>(Cur) + align - 1) & ~(align - 1);
+                }
+                Cur = reinterpret_cast<char*>(ptr + size);
+                return reinterpret_cast<void*>(ptr);
+            }
+            template<typename T, typename ...Args>
+            T* Emplace(Args&&... args) {
+                static_assert(std::is_trivially_destructible_v<T>, "TConcurrentPool doesn't call destructors");
+                return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            }
+        };
+    public:
+        /* blockSize is rounded up to a power of two and must be greater than the block header */
+        TConcurrentPool(const size_t blockSize = DefaultBlockSize)
+            : BlockSize(TUtil::NearestPowerOfTwo(blockSize))
+        {
+            if (BlockSize <= HeaderSize)
+                throw std::invalid_argument("TConcurrentPool: Block size is not enough to store the block header");
+        }
+        TConcurrentPool(const TConcurrentPool&) = delete;
+        TConcurrentPool& operator=(const TConcurrentPool&) = delete;
+        ~TConcurrentPool() {
+            for(TBlock* b = All.load(); b; ) {
+                TBlock* next = b->NextAll;
+                TBlockSource::DeAllocate(reinterpret_cast<char*>(b), b->Size);
+                b = next;
+            }
+        }
+        /* fills the cache with 'count' blocks in advance, safe while shards allocate:
+         * only new blocks are pushed, a block which was popped never comes back (no ABA)
+         */
+        void Reserve(size_t count) {
+            while(count--) {
+                TBlock* b = NewBlock();
+                b->NextFree = Free.load(std::memory_order_relaxed);
+                while(!Free.compare_exchange_weak(b->NextFree, b, std::memory_order_release))
+                    ;
+            }
+        }
+        /* all blocks go back to the cache, all shards must be destroyed already */
+        void Reset() noexcept {
+            TBlock* free = nullptr;
+            for(TBlock* b = All.load(std::memory_order_acquire); b; b = b->NextAll) {
+                b->NextFree = free;
+                free = b;
+            }
+            Free.store(free, std::memory_order_release);
+        }
+        size_t BlocksCount() const noexcept { return Count.load(std::memory_order_relaxed); }
+    };
+}
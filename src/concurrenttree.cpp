@@ -0,0 +1,300 @@
+#include "concurrenttree.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace NPrefix {
+    ui32 TConcurrentTree::Find(const TNode* n, const char c) noexcept {
+        const void* hit = std::memchr(First(n), ui8(c), n->Count);
+        return hit ? static_cast<const ui8*>(hit) - First(n) : n->Count;
+    }
+    const TConcurrentTree::TNode* TConcurrentTree::NewNode(const std::vector<TEntry>& entries) {
+        const ui32 count = entries.size();
+        ui32 labelBytes = 0;
+        for(const auto& e: entries)
+            labelBytes += e.Label.size();
+        char* mem = static_cast<char*>(::operator new(EdgesOffset(count) + count * sizeof(TEdge) + labelBytes));
+        TNode* n = new (mem) TNode{count, labelBytes};
+        ui8* first = reinterpret_cast<ui8*>(n + 1);
+        TEdge* edges = reinterpret_cast<TEdge*>(mem + EdgesOffset(count));
+        char* labels = reinterpret_cast<char*>(edges + count);
+        ui32 offset = 0;
+        for(ui32 i=0; i<count; ++i) {
+            const auto& e = entries[i];
+            first[i] = e.Label.front();
+            new (edges + i) TEdge{offset, ui32(e.Label.size()), e.Link};
+            std::memcpy(labels + offset, e.Label.data(), e.Label.size());
+            offset += e.Label.size();
+        }
+        return n;
+    }
+    void TConcurrentTree::DeleteNode(const TNode* n) noexcept {
+        ::operator delete(const_cast<TNode*>(n));
+    }
+    void TConcurrentTree::Entries(const TNode* n, std::vector<TEntry>& entries) {
+        entries.clear();
+        for(ui32 i=0; i<n->Count; ++i)
+            entries.push_back({Label(n, Edges(n)[i]), Edges(n)[i].Link});
+    }
+
+    TConcurrentTree::TConcurrentTree()
+        : Root(NewNode({}))
+    {}
+    TConcurrentTree::~TConcurrentTree() {
+        std::vector<const TNode*> todo{Root.load(std::memory_order_relaxed)};
+        while(!todo.empty()) {
+            const TNode* n = todo.back(); todo.pop_back();
+            for(ui32 i=0; i<n->Count; ++i)
+                if (Edges(n)[i].Link)
+                    todo.push_back(Edges(n)[i].Link);
+            DeleteNode(n);
+        }
+        for(const auto& r: Retired)
+            DeleteNode(r.Node);
+        for(TSlot* s=Slots.load(std::memory_order_relaxed); s;) {
+            TSlot* next = s->Next;
+            delete s;
+            s = next;
+        }
+    }
+
+    TConcurrentTree::TSlot* TConcurrentTree::Acquire() {
+        for(TSlot* s=Slots.load(std::memory_order_acquire); s; s=s->Next) {
+            bool busy = false;
+            if (!s->Busy.load(std::memory_order_relaxed) && s->Busy.compare_exchange_strong(busy, true, std::memory_order_acquire))
+                return s;
+        }
+        TSlot* s = new TSlot;
+        s->Next = Slots.load(std::memory_order_relaxed);
+        while(!Slots.compare_exchange_weak(s->Next, s, std::memory_order_release))
+            ;
+        return s;
+    }
+
+    /*
+     * The new root is stored before the epoch is advanced (both seq_cst), a reader announces
+     * its epoch before it loads the root: a reader which may still see the replaced nodes
+     * has announced an epoch <= the one they are retired with
+     */
+    void TConcurrentTree::Publish(const std::vector<std::pair<const TNode*, ui32>>& path, const TNode* fresh,
+                                  std::initializer_list<const TNode*> old)
+    {
+        std::vector<const TNode*> created{fresh};
+        try {
+            std::vector<TEntry> entries;
+            for(auto it=path.rbegin(); it!=path.rend(); ++it) {
+                Entries(it->first, entries);
+                entries[it->second].Link = created.back();
+                created.push_back(NewNode(entries));
+            }
+            const size_t retired = Retired.size() + path.size() + old.size();
+            if (Retired.capacity() < retired) // nothing may throw after the root is published
+                Retired.reserve(std::max(retired, 2 * Retired.capacity()));
+        } catch(...) {
+            for(const TNode* n: created)
+                DeleteNode(n);
+            throw;
+        }
+        Root.store(created.back(), std::memory_order_seq_cst);
+        const ui64 epoch = Epoch.fetch_add(1, std::memory_order_seq_cst);
+        for(const TNode* n: old)
+            Retired.push_back({epoch, n});
+        for(const auto& p: path)
+            Retired.push_back({epoch, p.first});
+        if (Retired.size() >= ReclaimBatch)
+            Reclaim();
+    }
+    void TConcurrentTree::Reclaim() noexcept {
+        ui64 oldest = std::numeric_limits<ui64>::max();
+        for(TSlot* s=Slots.load(std::memory_order_acquire); s; s=s->Next)
+            if (const ui64 e = s->Epoch.load(std::memory_order_seq_cst))
+                oldest = std::min(oldest, e);
+        // Retired is ordered by epochs
+        auto end = std::find_if(Retired.begin(), Retired.end(), [oldest](const TRetired& r) { return r.Epoch >= oldest; });
+        for(auto it=Retired.begin(); it!=end; ++it)
+            DeleteNode(it->Node);
+        Retired.erase(Retired.begin(), end);
+    }
+
+    bool TConcurrentTree::Append(std::string_view key) {
+        std::lock_guard lock(Writer);
+        std::string buf(key);
+        buf.push_back('\0');
+        const std::string_view x = buf;
+        std::vector<std::pair<const TNode*, ui32>> path;
+        std::vector<TEntry> entries;
+        const TNode* cur = Root.load(std::memory_order_relaxed);
+        for(size_t i=0;;) {
+            const ui32 pos = Find(cur, x[i]);
+            if (pos == cur->Count) { // a new edge
+                Entries(cur, entries);
+                auto it = std::lower_bound(entries.begin(), entries.end(), ui8(x[i]), [](const TEntry& e, ui8 c) {
+                    return ui8(e.Label.front()) < c;
+                });
+                entries.insert(it, {x.substr(i), nullptr});
+                Publish(path, NewNode(entries), {cur});
+                break;
+            }
+            const TEdge& edge = Edges(cur)[pos];
+            const std::string_view label = Label(cur, edge);
+            const std::string_view rest = x.substr(i);
+            size_t p = 0;
+            while(p < label.size() && label[p] == rest[p]) // rest ends with '\0'
+                ++p;
+            if (p == label.size()) {
+                if (!edge.Link) // '\0' has matched too
+                    return false;
+                path.emplace_back(cur, pos);
+                cur = edge.Link;
+                i += p;
+                continue;
+            }
+            // split the edge at p
+            std::vector<TEntry> split{{label.substr(p), edge.Link}, {rest.substr(p), nullptr}};
+            if (ui8(split[1].Label.front()) < ui8(split[0].Label.front()))
+                std::swap(split[0], split[1]);
+            const TNode* child = NewNode(split);
+            try {
+                Entries(cur, entries);
+                entries[pos] = {label.substr(0, p), child};
+                Publish(path, NewNode(entries), {cur});
+            } catch(...) {
+                DeleteNode(child);
+                throw;
+            }
+            break;
+        }
+        Size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool TConcurrentTree::Remove(std::string_view key) {
+        std::lock_guard lock(Writer);
+        std::string buf(key);
+        buf.push_back('\0');
+        const std::string_view x = buf;
+        std::vector<std::pair<const TNode*, ui32>> path;
+        const TNode* cur = Root.load(std::memory_order_relaxed);
+        ui32 pos;
+        for(size_t i=0;;) {
+            pos = Find(cur, x[i]);
+            if (pos == cur->Count)
+                return false;
+            const TEdge& edge = Edges(cur)[pos];
+            const std::string_view label = Label(cur, edge);
+            if (x.substr(i, label.size()) != label)
+                return false;
+            if (!edge.Link)
+                break;
+            path.emplace_back(cur, pos);
+            cur = edge.Link;
+            i += label.size();
+        }
+
+        std::vector<TEntry> entries;
+        Entries(cur, entries);
+        entries.erase(entries.begin() + pos);
+        if (entries.size() == 1 && !path.empty()) {
+            // one edge is left: it's joined with the edge of the parent
+            auto [parent, ppos] = path.back();
+            path.pop_back();
+            std::string joined(Label(parent, Edges(parent)[ppos]));
+            joined.append(entries.front().Label);
+            const TNode* link = entries.front().Link;
+            Entries(parent, entries);
+            entries[ppos] = {joined, link};
+            Publish(path, NewNode(entries), {parent, cur});
+        } else {
+            Publish(path, NewNode(entries), {cur});
+        }
+        Size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    TConcurrentTree::TReader::TReader(TConcurrentTree& tree)
+        : T(&tree)
+        , Slot(tree.Acquire())
+    {}
+    const TConcurrentTree::TNode* TConcurrentTree::TReader::Enter() const noexcept {
+        Slot->Epoch.store(T->Epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        return T->Root.load(std::memory_order_seq_cst);
+    }
+    void TConcurrentTree::TReader::Leave() const noexcept {
+        Slot->Epoch.store(0, std::memory_order_release);
+    }
+
+    bool TConcurrentTree::TReader::Exists(std::string_view key) const noexcept {
+        const TNode* cur = Enter();
+        bool found = false;
+        for(size_t i=0;;) {
+            const ui32 pos = Find(cur, i < key.size() ? key[i] : '\0');
+            if (pos == cur->Count)
+                break;
+            const TEdge& edge = Edges(cur)[pos];
+            const std::string_view label = Label(cur, edge);
+            if (!edge.Link) { // label is the rest of the key and '\0'
+                found = label.size() == key.size() - i + 1 && std::memcmp(label.data(), key.data() + i, label.size() - 1) == 0;
+                break;
+            }
+            if (key.size() - i < label.size() || std::memcmp(label.data(), key.data() + i, label.size()) != 0)
+                break;
+            i += label.size();
+            cur = edge.Link;
+        }
+        Leave();
+        return found;
+    }
+
+    void TConcurrentTree::TReader::ForEachWithPrefix(std::string_view prefix, const std::function<void(std::string_view)>& f) const {
+        struct TGuard {
+            const TReader* R;
+            ~TGuard() { R->Leave(); }
+        } guard{this};
+        struct TFrame {
+            const TNode* Node;
+            ui32 Next;
+            ui32 End;
+            size_t KeySize;
+        };
+        std::vector<TFrame> stack;
+        const TNode* cur = Enter();
+        for(size_t i=0;;) {
+            if (i == prefix.size()) {
+                stack.push_back({cur, 0, cur->Count, i});
+                break;
+            }
+            const ui32 pos = Find(cur, prefix[i]);
+            if (pos == cur->Count)
+                return;
+            const TEdge& edge = Edges(cur)[pos];
+            const std::string_view label = Label(cur, edge);
+            const size_t rest = prefix.size() - i;
+            if (label.compare(0, std::min(rest, label.size()), prefix.substr(i, label.size())) != 0)
+                return;
+            if (rest <= label.size()) { // the prefix ends on this edge
+                stack.push_back({cur, pos, pos + 1, i});
+                break;
+            }
+            i += label.size();
+            cur = edge.Link;
+        }
+
+        std::string key(prefix.substr(0, stack.back().KeySize));
+        while(!stack.empty()) {
+            TFrame& top = stack.back();
+            if (top.Next == top.End) {
+                stack.pop_back();
+                continue;
+            }
+            const TEdge& edge = Edges(top.Node)[top.Next++];
+            key.resize(top.KeySize);
+            key.append(Label(top.Node, edge));
+            if (!edge.Link) {
+                f(std::string_view(key.data(), key.size() - 1));
+                continue;
+            }
+            stack.push_back({edge.Link, 0, edge.Link->Count, key.size()});
+        }
+    }
+}
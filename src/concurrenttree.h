@@ -0,0 +1,129 @@
+#pragma once
+
+/*
+ *  Compressed prefix tree for many readers and one writer at a time
+ *  1. Nodes are immutable once published: Append/Remove copy the nodes on the modified path
+ *     (the changed node, its ancestors up to the root) and publish the new root atomically,
+ *     readers never lock: they see either the old or the new version of the whole tree
+ *  2. Replaced nodes are retired with the epoch of their replacement, a reader announces the
+ *     epoch it has started in, a retired node is freed when every active reader has started
+ *     after it was replaced (epoch based reclamation)
+ *  3. A node is one allocation: the first bytes of its edges (searched by memchr), the edges
+ *     and their labels, so a copy is one memcpy-like pass
+ *  4. Writers are serialized by a mutex, a writer never waits for readers
+ *
+ *   NPrefix::TConcurrentTree tree;
+ *   tree.Append("abc");        // the writer thread
+ *   // each reader thread
+ *   NPrefix::TConcurrentTree::TReader reader(tree);
+ *   reader.Exists("abc");
+ *   reader.ForEachWithPrefix("ab", [](std::string_view key) { ... });
+ * P.S. Keys must not contain '\0', it's the terminator (like in NPrefix::TTree)
+ */
+
+#include "defines.h"
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace NPrefix {
+    class TConcurrentTree {
+    private:
+        struct TNode;
+        struct TEdge {
+            ui32 Offset; // of the label in the node
+            ui32 Size;
+            const TNode* Link; // nullptr for a leaf, its label ends with '\0'
+        };
+        // followed by ui8 First[Count], TEdge Edges[Count] (aligned), char Labels[LabelBytes]
+        struct TNode {
+            ui32 Count;
+            ui32 LabelBytes;
+        };
+        // an edge of a node being built, the label is a view into an old node or the key
+        struct TEntry {
+            std::string_view Label;
+            const TNode* Link;
+        };
+        // a reader announces its epoch here, slots are reused by the next readers
+        struct alignas(64) TSlot {
+            std::atomic<ui64> Epoch{0}; // 0 - no read is in progress
+            std::atomic<bool> Busy{true};
+            TSlot* Next = nullptr;
+        };
+        struct TRetired {
+            ui64 Epoch;
+            const TNode* Node;
+        };
+        static constexpr size_t ReclaimBatch = 64;
+
+        std::atomic<const TNode*> Root;
+        std::atomic<ui64> Epoch{1};
+        std::atomic<TSlot*> Slots{nullptr};
+        std::atomic<ui64> Size{0};
+        std::mutex Writer;
+        std::vector<TRetired> Retired; // under Writer
+    private:
+        static const ui8* First(const TNode* n) noexcept {
+            return reinterpret_cast<const ui8*>(n + 1);
+        }
+        static size_t EdgesOffset(const ui32 count) noexcept {
+            return (sizeof(TNode) + count + alignof(TEdge) - 1) & ~(alignof(TEdge) - 1);
+        }
+        static const TEdge* Edges(const TNode* n) noexcept {
+            return reinterpret_cast<const TEdge*>(reinterpret_cast<const char*>(n) + EdgesOffset(n->Count));
+        }
+        static std::string_view Label(const TNode* n, const TEdge& e) noexcept {
+            return {reinterpret_cast<const char*>(Edges(n) + n->Count) + e.Offset, e.Size};
+        }
+        /* the index of the edge starting with c or Count */
+        static ui32 Find(const TNode* n, char c) noexcept;
+        static const TNode* NewNode(const std::vector<TEntry>& entries);
+        static void DeleteNode(const TNode* n) noexcept;
+        static void Entries(const TNode* n, std::vector<TEntry>& entries);
+
+        TSlot* Acquire();
+        /* copies the path with 'fresh' instead of its last node, publishes the new root */
+        void Publish(const std::vector<std::pair<const TNode*, ui32>>& path, const TNode* fresh,
+                     std::initializer_list<const TNode*> old);
+        void Reclaim() noexcept;
+    public:
+        class TReader {
+        private:
+            const TConcurrentTree* T;
+            TSlot* Slot;
+        private:
+            const TNode* Enter() const noexcept;
+            void Leave() const noexcept;
+        public:
+            TReader(TConcurrentTree& tree);
+            TReader(const TReader&) = delete;
+            TReader& operator=(const TReader&) = delete;
+            ~TReader() {
+                Slot->Busy.store(false, std::memory_order_release);
+            }
+            bool Exists(std::string_view key) const noexcept;
+            /* f(std::string_view) for keys with the prefix in order on one version of the tree */
+            void ForEachWithPrefix(std::string_view prefix, const std::function<void(std::string_view)>& f) const;
+        };
+    public:
+        TConcurrentTree();
+        TConcurrentTree(const TConcurrentTree&) = delete;
+        TConcurrentTree& operator=(const TConcurrentTree&) = delete;
+        ~TConcurrentTree();
+
+        bool Append(std::string_view key);
+        bool Remove(std::string_view key);
+        ui64 size() const noexcept { return Size.load(std::memory_order_relaxed); }
+        /* nodes waiting for readers */
+        size_t RetiredCount() {
+            std::lock_guard lock(Writer);
+            return Retired.size();
+        }
+    };
+}
@@ -0,0 +1,353 @@
+#include "frozentree.h"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace NPrefix {
+    namespace {
+        constexpr char Magic[8] = {'O', 'A', 'K', 'L', 'O', 'U', 'D', 'S'};
+        constexpr ui32 Version = 1;
+
+        ui64 Align8(const ui64 x) noexcept { return (x + 7) & ~ui64(7); }
+        ui64 WordsOf(const ui64 bits) noexcept { return (bits + 63) / 64; }
+
+        // the position of the k-th (0-based) set bit of w
+        ui64 SelectInWord(ui64 w, ui64 k) noexcept {
+#ifdef __BMI2__
+            return __builtin_ctzll(_pdep_u64(ui64(1) << k, w));
+#else
+            for(; k; --k)
+                w &= w - 1;
+            return __builtin_ctzll(w);
+#endif
+        }
+
+        struct TBitsBuilder {
+            std::vector<ui64> Words;
+            ui64 Size = 0;
+
+            void Push(const bool bit) {
+                if (Size % 64 == 0)
+                    Words.push_back(0);
+                Words.back() |= ui64(bit) << (Size % 64);
+                ++Size;
+            }
+        };
+
+        // the rank directory of words[0, bits) and the block of each sampleZeros-th zero
+        void Index(const ui64* words, const ui64 bits, const ui64 blockBits, ui64* ranks,
+                   const ui64 sampleZeros = 0, ui64* samples = nullptr) noexcept
+        {
+            const ui64 blocks = bits / blockBits + 1, words64 = WordsOf(bits), perBlock = blockBits / 64;
+            ui64 ones = 0;
+            for(ui64 b=0; b<=blocks; ++b) {
+                ranks[b] = ones;
+                for(ui64 w=b * perBlock; w<(b + 1) * perBlock && w<words64; ++w)
+                    ones += __builtin_popcountll(words[w]);
+            }
+            if (!samples)
+                return;
+            const ui64 zeros = bits - ones;
+            for(ui64 j=0, b=0; j<zeros / sampleZeros + 2; ++j) {
+                while(b + 1 < blocks && (b + 1) * blockBits - ranks[b + 1] <= j * sampleZeros)
+                    ++b;
+                samples[j] = b;
+            }
+        }
+    }
+
+    TFrozenTree::TLayout::TLayout(const THeader& h) noexcept {
+        const ui64 edges = h.Nodes - 1;
+        const ui64 loudsBits = h.Nodes + edges;
+        ui64 off = Align8(sizeof(THeader));
+        LoudsWords = off;   off += 8 * WordsOf(loudsBits);
+        LoudsRanks = off;   off += 8 * (loudsBits / BlockBits + 2);
+        LoudsSamples = off; off += 8 * (h.Nodes / SampleZeros + 2);
+        Labels = off;       off = Align8(off + edges);
+        TailWords = off;    off += 8 * WordsOf(edges);
+        TailRanks = off;    off += 8 * (edges / BlockBits + 2);
+        TailRefs = off;     off = Align8(off + 4 * h.Tails);
+        Blob = off;         off = Align8(off + h.BlobSize);
+        FileSize = off;
+    }
+
+    ui64 TFrozenTree::TBits::Rank1(const ui64 i) const noexcept {
+        const ui64 block = i / BlockBits;
+        ui64 rank = Ranks[block];
+        for(ui64 w=block * (BlockBits / 64); w<i / 64; ++w)
+            rank += __builtin_popcountll(Words[w]);
+        if (i % 64)
+            rank += __builtin_popcountll(Words[i / 64] & ((ui64(1) << (i % 64)) - 1));
+        return rank;
+    }
+    ui64 TFrozenTree::TBits::Select0(const ui64 k) const noexcept {
+        auto zeros = [this](const ui64 block) { // zeros before the block
+            return block * BlockBits - Ranks[block];
+        };
+        // the last block in [lo, hi] with zeros(block) <= k
+        ui64 lo = Samples[k / SampleZeros], hi = Samples[k / SampleZeros + 1];
+        while(lo < hi) {
+            const ui64 mid = (lo + hi + 1) / 2;
+            if (zeros(mid) <= k)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        ui64 rest = k - zeros(lo);
+        for(ui64 w=lo * (BlockBits / 64);; ++w) {
+            const ui64 z = 64 - __builtin_popcountll(Words[w]);
+            if (rest < z)
+                return w * 64 + SelectInWord(~Words[w], rest);
+            rest -= z;
+        }
+    }
+    ui64 TFrozenTree::TBits::NextZero(const ui64 i) const noexcept {
+        ui64 w = i / 64;
+        ui64 bits = ~Words[w] >> (i % 64);
+        if (bits)
+            return i + __builtin_ctzll(bits);
+        while(!(bits = ~Words[++w])); // the last bit of LOUDS is a zero
+        return w * 64 + __builtin_ctzll(bits);
+    }
+
+    std::pair<ui64, ui64> TFrozenTree::Children(const ui64 v) const noexcept {
+        const ui64 begin = v ? Louds.Select0(v - 1) + 1 : 0;
+        const ui64 end = Louds.NextZero(begin);
+        return {begin - v, end - v}; // ones before the position are edges
+    }
+    std::string_view TFrozenTree::Tail(const ui64 e) const noexcept {
+        if (!HasTail[e])
+            return {};
+        const ui8* p = Blob + TailRefs[HasTail.Rank1(e)];
+        size_t size = 0;
+        for(ui32 shift=0;; shift+=7) { // varint
+            size |= size_t(*p & 0x7F) << shift;
+            if (!(*p++ & 0x80))
+                break;
+        }
+        return {reinterpret_cast<const char*>(p), size};
+    }
+
+    void TFrozenTree::Attach(const char* data) {
+        Data = data;
+        Header = reinterpret_cast<const THeader*>(data);
+        const TLayout l(*Header);
+        auto at = [data](const ui64 offset) { return reinterpret_cast<const ui64*>(data + offset); };
+        Louds = {at(l.LoudsWords), at(l.LoudsRanks), at(l.LoudsSamples), 2 * Header->Nodes - 1};
+        HasTail = {at(l.TailWords), at(l.TailRanks), nullptr, Header->Nodes - 1};
+        Labels = reinterpret_cast<const ui8*>(data + l.Labels);
+        TailRefs = reinterpret_cast<const ui32*>(data + l.TailRefs);
+        Blob = reinterpret_cast<const ui8*>(data + l.Blob);
+    }
+    void TFrozenTree::Release() noexcept {
+        if (MappedSize)
+            munmap(const_cast<char*>(Data), MappedSize);
+        Own.clear();
+        Data = nullptr;
+        MappedSize = 0;
+        Header = nullptr;
+    }
+    TFrozenTree::TFrozenTree(TFrozenTree&& other) noexcept {
+        *this = std::move(other);
+    }
+    TFrozenTree& TFrozenTree::operator=(TFrozenTree&& other) noexcept {
+        if (this == &other)
+            return *this;
+        Release();
+        Own = std::move(other.Own); // the buffer doesn't move
+        MappedSize = other.MappedSize;
+        if (other.Data)
+            Attach(other.Data);
+        other.MappedSize = 0;
+        other.Release();
+        return *this;
+    }
+
+    template<typename TAllocator>
+    TFrozenTree TFrozenTree::Freeze(const TBasicTree<TAllocator>& tree) {
+        using TNode = TBasicNode<TAllocator>;
+        TBitsBuilder louds, hasTail;
+        std::vector<ui8> labels;
+        std::vector<ui32> tailRefs;
+        std::string blob;
+        std::unordered_map<std::string_view, ui32> shared; // views of the labels of the tree
+
+        std::vector<const TNode*> bfs{&tree.Root}; // nullptr is a leaf
+        for(size_t i=0; i<bfs.size(); ++i) {
+            if (bfs[i])
+                for(const auto& inner: bfs[i]->Keys) {
+                    const std::string_view label = tree.Label(inner);
+                    louds.Push(true);
+                    labels.push_back(label.front());
+                    hasTail.Push(label.size() > 1);
+                    if (label.size() > 1) {
+                        const std::string_view tail = label.substr(1);
+                        auto [it, fresh] = shared.try_emplace(tail, ui32(blob.size()));
+                        if (fresh) {
+                            if (blob.size() + tail.size() + 8 > std::numeric_limits<ui32>::max())
+                                throw std::length_error("TFrozenTree: tails are over 4G");
+                            for(size_t size=tail.size(); ; size>>=7) {
+                                blob.push_back(char((size & 0x7F) | (size > 0x7F ? 0x80 : 0)));
+                                if (size <= 0x7F)
+                                    break;
+                            }
+                            blob.append(tail);
+                        }
+                        tailRefs.push_back(it->second);
+                    }
+                    bfs.push_back(tree.Child(inner));
+                }
+            louds.Push(false);
+        }
+
+        THeader h = {};
+        std::memcpy(h.Magic, Magic, sizeof(Magic));
+        h.Version = Version;
+        h.HeaderSize = sizeof(THeader);
+        h.Keys = tree.size();
+        h.Nodes = bfs.size();
+        h.Tails = tailRefs.size();
+        h.BlobSize = blob.size();
+        const TLayout l(h);
+        h.FileSize = l.FileSize;
+
+        TFrozenTree frozen;
+        frozen.Own.resize(l.FileSize / 8);
+        char* data = reinterpret_cast<char*>(frozen.Own.data());
+        auto at = [data](const ui64 offset) { return reinterpret_cast<ui64*>(data + offset); };
+        auto put = [data](const ui64 offset, const void* from, const size_t size) {
+            if (size) // an empty section has no source (an empty tree, no tails)
+                std::memcpy(data + offset, from, size);
+        };
+        put(0, &h, sizeof(h));
+        put(l.LoudsWords, louds.Words.data(), louds.Words.size() * 8);
+        Index(louds.Words.data(), louds.Size, BlockBits, at(l.LoudsRanks), SampleZeros, at(l.LoudsSamples));
+        put(l.Labels, labels.data(), labels.size());
+        put(l.TailWords, hasTail.Words.data(), hasTail.Words.size() * 8);
+        Index(hasTail.Words.data(), hasTail.Size, BlockBits, at(l.TailRanks));
+        put(l.TailRefs, tailRefs.data(), tailRefs.size() * 4);
+        put(l.Blob, blob.data(), blob.size());
+        frozen.Attach(data);
+        return frozen;
+    }
+
+    TFrozenTree TFrozenTree::Open(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("TFrozenTree: can't open " + path);
+        struct stat st;
+        const bool sized = fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(THeader);
+        void* ptr = sized ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (ptr == MAP_FAILED)
+            throw std::runtime_error("TFrozenTree: can't map " + path);
+
+        const THeader& h = *static_cast<const THeader*>(ptr);
+        if (std::memcmp(h.Magic, Magic, sizeof(Magic)) != 0 || h.Version != Version
+            || h.HeaderSize != sizeof(THeader) || h.Nodes == 0 || h.Nodes > (ui64(1) << 40)
+            || h.FileSize != ui64(st.st_size) || TLayout(h).FileSize != h.FileSize)
+        {
+            munmap(ptr, st.st_size);
+            throw std::runtime_error("TFrozenTree: " + path + " is not a frozen tree");
+        }
+        TFrozenTree frozen;
+        frozen.MappedSize = st.st_size;
+        frozen.Attach(static_cast<const char*>(ptr));
+        return frozen;
+    }
+    void TFrozenTree::Save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        const std::string_view image = Image();
+        out.write(image.data(), image.size());
+        if (!out)
+            throw std::runtime_error("TFrozenTree: can't write " + path);
+    }
+
+    bool TFrozenTree::Exists(const std::string_view key) const noexcept {
+        if (!Header)
+            return false;
+        ui64 v = 0;
+        for(size_t i=0;;) {
+            const auto [begin, end] = Children(v);
+            const ui8 c = i < key.size() ? key[i] : 0; // the implicit '\0' in the end
+            const void* hit = std::memchr(Labels + begin, c, end - begin);
+            if (!hit)
+                return false;
+            if (c == 0)
+                return true;
+            const ui64 e = static_cast<const ui8*>(hit) - Labels;
+            const std::string_view tail = Tail(e);
+            ++i;
+            if (!tail.empty() && tail.back() == '\0') // a leaf
+                return key.substr(i) == tail.substr(0, tail.size() - 1);
+            if (key.substr(i, tail.size()) != tail)
+                return false;
+            i += tail.size();
+            v = e + 1;
+        }
+    }
+    TFrozenTree::TIterator TFrozenTree::KeysWithPrefix(const std::string_view prefix) const {
+        if (!Header)
+            return TIterator();
+        ui64 v = 0;
+        for(size_t i=0; i<prefix.size();) {
+            const auto [begin, end] = Children(v);
+            const void* hit = std::memchr(Labels + begin, ui8(prefix[i]), end - begin);
+            if (!hit)
+                return TIterator();
+            const ui64 e = static_cast<const ui8*>(hit) - Labels;
+            const std::string_view tail = Tail(e);
+            const size_t rest = prefix.size() - i - 1;
+            const size_t n = std::min(rest, tail.size());
+            if (prefix.substr(i + 1, n) != tail.substr(0, n))
+                return TIterator();
+            if (rest <= tail.size()) // the prefix ends on this edge
+                return TIterator(this, prefix.substr(0, i), e, e + 1);
+            i += 1 + tail.size();
+            v = e + 1;
+        }
+        const auto [begin, end] = Children(v);
+        return TIterator(this, prefix, begin, end);
+    }
+
+    TFrozenTree::TIterator::TIterator(const TFrozenTree* tree, std::string_view prefix, ui64 begin, ui64 end)
+        : T(tree)
+        , K(prefix)
+    {
+        S.push_back({begin, end, K.size()});
+        Next();
+    }
+    void TFrozenTree::TIterator::Next() {
+        while(!S.empty()) {
+            TFrame& f = S.back();
+            if (f.Next == f.End) {
+                S.pop_back();
+                continue;
+            }
+            const ui64 e = f.Next++;
+            K.resize(f.KeySize);
+            K.push_back(T->Labels[e]);
+            K.append(T->Tail(e));
+            if (K.back() == '\0') {
+                K.pop_back();
+                Valid = true;
+                return;
+            }
+            const auto [begin, end] = T->Children(e + 1);
+            S.push_back({begin, end, K.size()});
+        }
+        Valid = false;
+    }
+
+    template TFrozenTree TFrozenTree::Freeze(const TBasicTree<std::allocator<char>>&);
+    template TFrozenTree TFrozenTree::Freeze(const TBasicTree<std::pmr::polymorphic_allocator<char>>&);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+/*
+ *  Frozen (read-only) form of NPrefix::TTree: a LOUDS succinct trie in one flat image
+ *  1. Nodes are numbered in BFS order (the root is 0, the edge e leads to the node e+1),
+ *     the LOUDS bitvector keeps 1^degree 0 per node: children of v are found by two
+ *     select0 queries, rank/select are answered by a directory of 512-bit blocks
+ *  2. The first bytes of edge labels are a flat array (children of a node are contiguous
+ *     and sorted), the rest of a label (a tail) is found via rank on the "has tail" bitvector
+ *  3. Tails are deduplicated ("ing\0", "s\0" are shared by thousands of leaves) and kept
+ *     as (varint length, bytes) in a blob
+ *  4. The image is the file: Open() mmaps it and queries run on the mapping, nothing is
+ *     deserialized, the pages are shared by all processes which serve the same file
+ *
+ *   NPrefix::TFrozenTree::Freeze(tree).Save("dict.louds");
+ *   auto frozen = NPrefix::TFrozenTree::Open("dict.louds");
+ *   frozen.Exists("abc");
+ *   for(auto it=frozen.KeysWithPrefix("ab");it;++it)
+ *       std::cout << it.Key() << '\n';
+ * P.S. Keys are visited in the std::string order, '\0' is the terminator (like in TTree)
+ * P.P.S. The image is little-endian, Open() checks the header and sizes but trusts the content
+ */
+
+#include "defines.h"
+#include "prefixtree.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace NPrefix {
+    class TFrozenTree {
+    private:
+        static constexpr ui64 BlockBits = 512;   // a rank directory entry per block
+        static constexpr ui64 SampleZeros = 512; // a select0 sample per this many zeros
+
+        struct THeader {
+            char Magic[8];
+            ui32 Version;
+            ui32 HeaderSize;
+            ui64 Keys;
+            ui64 Nodes;    // edges = Nodes - 1
+            ui64 Tails;
+            ui64 BlobSize;
+            ui64 FileSize;
+        };
+        // byte offsets of the sections, all of them are 8-byte aligned
+        struct TLayout {
+            ui64 LoudsWords, LoudsRanks, LoudsSamples;
+            ui64 Labels;
+            ui64 TailWords, TailRanks;
+            ui64 TailRefs;
+            ui64 Blob;
+            ui64 FileSize;
+
+            TLayout(const THeader& h) noexcept;
+        };
+        // a view of a bitvector with its rank directory (and select0 samples)
+        struct TBits {
+            const ui64* Words = nullptr;
+            const ui64* Ranks = nullptr;   // ones before each block, one more in the end
+            const ui64* Samples = nullptr; // the block of each SampleZeros-th zero
+            ui64 Size = 0;
+
+            bool operator[](const ui64 i) const noexcept {
+                return (Words[i / 64] >> (i % 64)) & 1;
+            }
+            /* ones in [0, i) */
+            ui64 Rank1(ui64 i) const noexcept;
+            /* the position of the k-th (0-based) zero */
+            ui64 Select0(ui64 k) const noexcept;
+            /* the position of the first zero at or after i */
+            ui64 NextZero(ui64 i) const noexcept;
+        };
+
+        std::vector<ui64> Own;     // the image built by Freeze()
+        const char* Data = nullptr;
+        size_t MappedSize = 0;     // the image is mmaped by Open()
+        const THeader* Header = nullptr;
+        TBits Louds;
+        TBits HasTail;
+        const ui8* Labels = nullptr;
+        const ui32* TailRefs = nullptr;
+        const ui8* Blob = nullptr;
+    private:
+        void Attach(const char* data);
+        void Release() noexcept;
+        /* the range of edges of the node v */
+        std::pair<ui64, ui64> Children(ui64 v) const noexcept;
+        std::string_view Tail(ui64 e) const noexcept;
+    public:
+        class TIterator {
+        private:
+            struct TFrame {
+                ui64 Next; // edges
+                ui64 End;
+                size_t KeySize;
+            };
+            const TFrozenTree* T = nullptr;
+            std::vector<TFrame> S;
+            std::string K;
+            bool Valid = false;
+        private:
+            void Next();
+        public:
+            TIterator() {}
+            TIterator(const TFrozenTree* tree, std::string_view prefix, ui64 begin, ui64 end);
+            const std::string& Key() const noexcept { return K; }
+            operator bool() const noexcept { return Valid; }
+            TIterator& operator ++() {
+                Next();
+                return *this;
+            }
+        };
+    public:
+        TFrozenTree() {}
+        TFrozenTree(TFrozenTree&& other) noexcept;
+        TFrozenTree& operator=(TFrozenTree&& other) noexcept;
+        TFrozenTree(const TFrozenTree&) = delete;
+        TFrozenTree& operator=(const TFrozenTree&) = delete;
+        ~TFrozenTree() {
+            Release();
+        }
+
+        template<typename TAllocator>
+        static TFrozenTree Freeze(const TBasicTree<TAllocator>& tree);
+        /* maps the file read-only, throws std::runtime_error if it's not a frozen tree */
+        static TFrozenTree Open(const std::string& path);
+        void Save(const std::string& path) const;
+        /* the image (what Save() writes) */
+        std::string_view Image() const noexcept {
+            return {Data, Data ? size_t(Header->FileSize) : 0};
+        }
+
+        bool Exists(std::string_view key) const noexcept;
+        TIterator KeysWithPrefix(std::string_view prefix) const;
+        TIterator AllKeys() const {
+            return KeysWithPrefix(std::string_view());
+        }
+        ui64 size() const noexcept { return Header ? Header->Keys : 0; }
+    };
+}
@@ -2,8 +2,16 @@
 
 
 #include "defines.h"
+#include <bit>
+#include <cstddef>
+#include <algorithm>
 #include <cstring>
-#include <stdexcept>
+#include <limits>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 
@@ -25,6 +33,12 @@ namespace NMemory {
             size |= size >> 32; // => 8 bytes
             ++size; return size;
         }
+        /* makes the next push_back nothrow, keeping the geometric growth */
+        template<typename TVector>
+        static void ReserveOneMore(TVector& v) {
+            if (v.size() == v.capacity())
+                v.reserve(std::max<size_t>(4, v.size() * 2));
+        }
     };
     struct TLinearStrategy {
         static inline size_t GetNextSize(const size_t size) noexcept {
@@ -37,75 +51,263 @@ namespace NMemory {
         }
     };
 
-    template<typename TStrategy = TLinearStrategy>
+    /* allocation statistics snapshot, all sizes are in bytes */
+    struct TStats {
+        static constexpr size_t BucketsCount = 16;
+
+        size_t Requested = 0;   // sum of requested sizes (since construction)
+        size_t Allocations = 0; // count of requests (since construction)
+        size_t Reserved = 0;    // blocks and large allocations held now
+        size_t Peak = 0;        // max of Reserved
+        size_t TailWaste = 0;   // unused ends of the blocks left behind by the bump pointer
+        // Buckets[i] counts requests of (2^(i-1), 2^i] bytes, the last one counts the rest
+        size_t Buckets[BucketsCount] = {};
+
+        static size_t Bucket(const size_t size) noexcept {
+            size_t b = std::bit_width(size - (size != 0));
+            return b < BucketsCount ? b : BucketsCount - 1;
+        }
+        void Count(const size_t size) noexcept {
+            Requested += size;
+            ++Allocations;
+            ++Buckets[Bucket(size)];
+        }
+    };
+
+    /* doubles the block size until MaxBlockSize is reached */
+    template<size_t MaxBlockSize = (64 << 20)>
+    struct TBoundedExponentialStrategy {
+        static inline size_t GetNextSize(const size_t size) noexcept {
+            return size < MaxBlockSize ? size << 1 : size;
+        }
+    };
+
+    /* Block source contract: static Allocate(size) may round the size up and reports it back,
+     * static DeAllocate(ptr, size) gets the reported size
+     */
+    struct THeapBlockSource {
+        static char* Allocate(size_t& size) {
+            return new char[size];
+        }
+        static void DeAllocate(char* ptr, size_t) noexcept {
+            delete[] ptr;
+        }
+    };
+
+    /*
+     * Bump allocator over a list of blocks
+     *  1. Requests which don't fit into a block (or bigger than SetLargeSize()) are allocated
+     *     separately in the list of large allocations
+     *  2. SetBudget() limits the total size of blocks and large allocations, std::bad_alloc is
+     *     thrown when the limit is hit, the pool stays untouched
+     *  3. Reuse cycles: ReAllocate() starts over from the first block size, RightSize() from one
+     *     block of the cycle's high watermark, Retain(n) keeps the n largest blocks, Reset() keeps
+     *     everything and Trim() gives the blocks which aren't in use back
+     */
+    template<typename TStrategy = TLinearStrategy, typename TBlockSource = THeapBlockSource>
     class TPool {
     private:
         static constexpr size_t DefaultBlockSize = 4096;
         struct TBlock {
             char* Ptr;
             size_t Size;
+            size_t Tail = 0; // unused bytes when the bump pointer has left the block
+        };
+        /* objects with non-trivial destructors registered by Emplace,
+         * the list lives in the pool itself and is unwound in LIFO order
+         */
+        struct TDestructor {
+            void (*Destroy)(void*);
+            void* Obj;
+            TDestructor* Next;
         };
         std::vector<TBlock> B;
+        std::vector<TBlock> L; // large allocations
+        size_t Cur = 0; // blocks after the current one are kept by Rewind/Reset for reuse
         size_t Occupied = 0;
+        TDestructor* D = nullptr;
+        size_t FirstSize;
+        size_t CyclePeak = 0; // bump bytes before the last Rewind/Reset of the cycle
+
+        size_t LargeSize = std::numeric_limits<size_t>::max();
+        size_t Budget = std::numeric_limits<size_t>::max();
+        size_t Reserved = 0;
+        TStats S;
+    public:
+        struct TMark {
+            size_t Block;
+            size_t Occupied;
+            size_t Large;
+            const void* D;
+        };
     private:
         size_t CurBlockSize() const noexcept {
-            return B.back().Size;
+            return B[Cur].Size;
         }
         char* CurBlockPtr() const noexcept {
-            return B.back().Ptr;
+            return B[Cur].Ptr;
         }
         void* CurPtr() const noexcept {
             return CurBlockPtr() + Occupied;
         }
-        void AllocateBlock(const size_t size) {
-            char* ptr = new char[size];
-            B.push_back({ptr, size});
+        size_t Padding(const size_t align) const noexcept {
+            return -reinterpret_cast<uintptr_t>(CurPtr()) & (align - 1);
+        }
+        TBlock AllocateMemory(size_t size) {
+            if (Reserved > Budget || size > Budget - Reserved)
+                throw std::bad_alloc();
+            char* ptr = TBlockSource::Allocate(size);
+            if (Reserved > Budget || size > Budget - Reserved) { // the source has rounded the size up
+                TBlockSource::DeAllocate(ptr, size);
+                throw std::bad_alloc();
+            }
+            Reserved += size;
+            S.Peak = std::max(S.Peak, Reserved);
+            return {ptr, size};
+        }
+        void DeAllocateMemory(const TBlock b) noexcept {
+            TBlockSource::DeAllocate(b.Ptr, b.Size);
+            Reserved -= b.Size;
+        }
+        void AllocateBlock(size_t size) {
+            TUtil::ReserveOneMore(B); // don't lose the block if push_back throws
+            B.push_back(AllocateMemory(size));
         }
         void Grow() {
-            AllocateBlock(TStrategy::GetNextSize(CurBlockSize()));
-            Occupied = 0;
-        }
-        void CheckSize(const size_t size) {
-            size_t bs = CurBlockSize();
-            if (size > bs)
-                throw std::runtime_error("TPool: Current block size is not enough to store at least 1 element");
-            if (Occupied + size > bs)
+            B[Cur].Tail = CurBlockSize() - Occupied;
+            if (Cur + 1 == B.size())
+                AllocateBlock(TStrategy::GetNextSize(CurBlockSize()));
+            ++Cur; Occupied = 0;
+        }
+        char* AllocateLarge(const size_t size, const size_t align) {
+            TUtil::ReserveOneMore(L);
+            TBlock b = AllocateMemory(size + align - 1);
+            L.push_back(b);
+            return b.Ptr + (-reinterpret_cast<uintptr_t>(b.Ptr) & (align - 1));
+        }
+        // the only place where the bump pointer moves forward
+        char* Reserve(const size_t size, const size_t align) {
+            if (size > std::numeric_limits<size_t>::max() - (align - 1)) // size + align - 1 overflows
+                throw std::bad_alloc();
+            S.Count(size);
+            if (size > LargeSize || size + align - 1 > CurBlockSize())
+                return AllocateLarge(size, align);
+            size_t pad = Padding(align);
+            if (Occupied + pad + size > CurBlockSize()) {
                 Grow();
+                pad = Padding(align);
+                if (pad + size > CurBlockSize()) // only a bounded strategy may shrink blocks
+                    return AllocateLarge(size, align);
+            }
+            char* ptr = static_cast<char*>(CurPtr()) + pad;
+            Occupied += pad + size;
+            return ptr;
         }
-    public:
-        TPool() {
-            AllocateBlock(DefaultBlockSize);
+        void DestroyObjects(const void* until = nullptr) noexcept {
+            for(; D != until; D = D->Next)
+                D->Destroy(D->Obj);
         }
-        TPool(const size_t blockSize) {
-            AllocateBlock(TUtil::NearestPowerOfTwo(blockSize));
+        void DeAllocateLarge(const size_t keep = 0) noexcept {
+            while(L.size() > keep) {
+                DeAllocateMemory(L.back());
+                L.pop_back();
+            }
         }
-        void ReAllocate() {
+        void DeAllocateBlocks() noexcept {
             for(TBlock b: B)
-                delete[] b.Ptr;
-
-            size_t firstSize = B.front().Size;
+                DeAllocateMemory(b);
             B.clear();
-
-            AllocateBlock(firstSize);
-            Occupied = 0;
+        }
+        // bytes taken by the bump pointer from the blocks, padding included
+        size_t Used() const noexcept {
+            size_t used = Occupied;
+            for(size_t i=0; i<Cur; ++i)
+                used += B[i].Size - B[i].Tail;
+            return used;
+        }
+        void Release() noexcept {
+            DestroyObjects();
+            DeAllocateLarge();
+            Cur = 0; Occupied = 0;
+            CyclePeak = 0;
+        }
+        template<typename T>
+        static void DestroyObject(void* obj) noexcept {
+            static_cast<T*>(obj)->~T();
+        }
+    public:
+        TPool()
+            : FirstSize(DefaultBlockSize)
+        {
+            AllocateBlock(FirstSize);
+        }
+        TPool(const size_t blockSize)
+            : FirstSize(TUtil::NearestPowerOfTwo(blockSize))
+        {
+            AllocateBlock(FirstSize);
+        }
+        TPool(const TPool&) = delete;
+        TPool& operator=(const TPool&) = delete;
+        void ReAllocate() {
+            Release();
+            DeAllocateBlocks();
+            AllocateBlock(FirstSize);
+        }
+        /* ReAllocate() for the batch jobs: the next cycle starts with one block big enough
+         * for the whole previous cycle, so a similar cycle doesn't Grow() at all,
+         * a kept block which is big enough is reused
+         */
+        void RightSize() {
+            size_t size = std::max(FirstSize, TUtil::NearestPowerOfTwo(HighWatermark()));
+            Release();
+            auto fit = B.end();
+            for(auto b = B.begin(); b != B.end(); ++b)
+                if (b->Size >= size && (fit == B.end() || b->Size < fit->Size))
+                    fit = b;
+            if (fit != B.end()) {
+                std::swap(B.front(), *fit);
+                Trim();
+            } else {
+                DeAllocateBlocks();
+                AllocateBlock(size);
+            }
+        }
+        /* Reset() which keeps only the 'count' (at least one) largest blocks, the largest goes first */
+        void Retain(size_t count) noexcept {
+            Release();
+            count = std::clamp<size_t>(count, 1, B.size());
+            std::partial_sort(B.begin(), B.begin() + count, B.end(), [](const TBlock& l, const TBlock& r) {
+                return l.Size > r.Size;
+            });
+            Trim(count);
+        }
+        /* gives back the blocks after the current one (kept by Rewind/Reset), but not less than 'keep' */
+        void Trim(const size_t keep = 1) noexcept {
+            const size_t count = std::max(Cur + 1, keep);
+            while(B.size() > count) {
+                DeAllocateMemory(B.back());
+                B.pop_back();
+            }
         }
         ~TPool() {
-            for(TBlock b: B)
-                delete[] b.Ptr;
+            DestroyObjects();
+            DeAllocateLarge();
+            DeAllocateBlocks();
         }
+
+        /* requests bigger than 'size' go to the list of large allocations,
+         * by default only those which don't fit into the current block go there
+         */
+        void SetLargeSize(const size_t size) noexcept { LargeSize = size; }
+        /* the limit of the total reserved memory, blocks which are already allocated are kept */
+        void SetBudget(const size_t budget) noexcept { Budget = budget; }
+
         void* Append(const size_t size) {
-            CheckSize(size);
-            char* bytes = static_cast<char*>(CurPtr());
-            Occupied += size;
-            return bytes;
+            return Reserve(size, 1);
         }
         char* Append(const char* ptr, const size_t size) {
-            CheckSize(size);
-
-            char* strPtr = static_cast<char*>(CurPtr());
+            char* strPtr = Reserve(size, 1);
             std::memcpy(strPtr, ptr, size);
-
-            Occupied += size;
             return strPtr;
         }
         template<size_t N>
@@ -114,15 +316,102 @@ namespace NMemory {
         }
         template<typename T>
         T* Append(const T& e) {
-            CheckSize(sizeof(T));
-
-            T* objPtr = static_cast<T*>(CurPtr());
+            T* objPtr = static_cast<T*>(Allocate(sizeof(T), alignof(T)));
             new (objPtr) T(e);
-
-            Occupied += sizeof(T);
             return objPtr;
         } // calling destructor of object T is the user's responsibility
+        /* 'count' default initialized T in a row (one allocation), the same rule for destructors */
+        template<typename T>
+        std::span<T> AppendN(const size_t count) {
+            if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+                throw std::bad_alloc();
+            T* ptr = static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+            std::uninitialized_default_construct_n(ptr, count);
+            return {ptr, count};
+        }
+        /* resizes the last allocation in place if it still fits into the current block,
+         * the content is kept, false means nothing has changed and the caller has to copy
+         *   if (!pool.TryExtend(buf, size, size * 2)) // allocate, copy
+         */
+        bool TryExtend(void* ptr, const size_t oldSize, const size_t newSize) noexcept {
+            char* p = static_cast<char*>(ptr);
+            if (p < CurBlockPtr() || p + oldSize != CurPtr() || newSize > CurBlockSize() - (Occupied - oldSize))
+                return false;
+            Occupied = Occupied - oldSize + newSize;
+            if (newSize > oldSize)
+                S.Requested += newSize - oldSize;
+            return true;
+        }
+
+        /* raw memory, 'align' must be a power of two */
+        void* Allocate(const size_t size, const size_t align = alignof(std::max_align_t)) {
+            return Reserve(size, align);
+        }
+        /* constructs T in place, the destructor of T (if any) is called by ReAllocate() or ~TPool()
+         * in the reverse order of construction
+         */
+        template<typename T, typename ...Args>
+        T* Emplace(Args&&... args) {
+            if constexpr (std::is_trivially_destructible_v<T>) {
+                void* ptr = Allocate(sizeof(T), alignof(T));
+                return new (ptr) T(std::forward<Args>(args)...);
+            } else {
+                // reserve the registry entry first: nothing may throw after T is constructed
+                void* dPtr = Allocate(sizeof(TDestructor), alignof(TDestructor));
+                void* ptr = Allocate(sizeof(T), alignof(T));
+                T* obj = new (ptr) T(std::forward<Args>(args)...);
+                D = new (dPtr) TDestructor{&DestroyObject<T>, obj, D};
+                return obj;
+            }
+        }
+
+        /* scratch mode: Rewind(mark) destroys the objects emplaced after Mark() and
+         * moves the bump pointer back, the blocks stay allocated for reuse,
+         * large allocations made after Mark() are freed
+         *   auto mark = pool.Mark();
+         *   // ... per request allocations ...
+         *   pool.Rewind(mark);
+         */
+        TMark Mark() const noexcept {
+            return {Cur, Occupied, L.size(), D};
+        }
+        void Rewind(const TMark& mark) noexcept {
+            CyclePeak = std::max(CyclePeak, Used());
+            DestroyObjects(mark.D);
+            DeAllocateLarge(mark.Large);
+            Cur = mark.Block; Occupied = mark.Occupied;
+        }
+        // same as ReAllocate(), but keeps all the blocks
+        void Reset() noexcept {
+            Rewind({0, 0, 0, nullptr});
+        }
+        class TScope {
+        private:
+            TPool& P;
+            TMark M;
+        public:
+            TScope(TPool& pool)
+                : P(pool)
+                , M(pool.Mark())
+            {}
+            TScope(const TScope&) = delete;
+            TScope& operator=(const TScope&) = delete;
+            ~TScope() { P.Rewind(M); }
+        };
 
+        TStats Stats() const noexcept {
+            TStats s = S;
+            s.Reserved = Reserved;
+            for(size_t i=0; i<Cur; ++i)
+                s.TailWaste += B[i].Tail;
+            return s;
+        }
+        /* max bytes taken from the blocks since the last ReAllocate/RightSize/Retain,
+         * large allocations aren't counted
+         */
+        size_t HighWatermark() const noexcept { return std::max(CyclePeak, Used()); }
         size_t BlocksCount() const noexcept { return B.size(); }
+        size_t LargeCount() const noexcept { return L.size(); }
+        size_t ReservedBytes() const noexcept { return Reserved; }
     };
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+ * mmap based block source for NMemory::TPool (Linux)
+ *  1. HugePages: try MAP_HUGETLB (reserved 2M pages) first, fall back to a 2M aligned
+ *     anonymous mapping with madvise(MADV_HUGEPAGE) (transparent huge pages, best effort)
+ *  2. Prefault: the pages are populated on allocation instead of on the first touch
+ *  3. Block sizes are rounded up to the page size (2M if MAP_HUGETLB has succeeded),
+ *     the pool uses the whole mapping
+ *
+ *   NMemory::TPool<NMemory::TLinearStrategy, NMemory::TMmapBlockSource<>> pool(2 << 20);
+ */
+
+#include "defines.h"
+#include <cstddef>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace NMemory {
+    template<bool HugePages = true, bool Prefault = false>
+    struct TMmapBlockSource {
+        static constexpr size_t HugePageSize = 2 << 20;
+
+        static size_t RoundUp(const size_t size, const size_t page) noexcept {
+            return (size + page - 1) & ~(page - 1);
+        }
+        static char* Map(const size_t size, const int flags) noexcept {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+            return ptr == MAP_FAILED ? nullptr : static_cast<char*>(ptr);
+        }
+        // THP needs 2M aligned ranges: map more than needed and cut the edges off
+        static char* MapAligned(const size_t size) noexcept {
+            char* raw = Map(size + HugePageSize, 0);
+            if (!raw) return nullptr;
+            char* ptr = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(raw), HugePageSize));
+            if (ptr != raw)
+                munmap(raw, ptr - raw);
+            munmap(ptr + size, raw + HugePageSize - ptr);
+            return ptr;
+        }
+        static void Populate(char* ptr, const size_t size) noexcept {
+#ifdef MADV_POPULATE_WRITE
+            if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+                return;
+#endif
+            const size_t page = sysconf(_SC_PAGESIZE);
+            for(size_t i=0; i<size; i+=page) // pre 5.14 kernels
+                ptr[i] = 0;
+        }
+
+        static char* Allocate(size_t& size) {
+            constexpr int populate = Prefault ? MAP_POPULATE : 0;
+            if constexpr (HugePages) {
+                size_t hugeSize = RoundUp(size, HugePageSize);
+                if (char* ptr = Map(hugeSize, MAP_HUGETLB | populate)) {
+                    size = hugeSize;
+                    return ptr;
+                }
+                if (size >= HugePageSize) {
+                    size = hugeSize;
+                    char* ptr = MapAligned(size);
+                    if (!ptr) throw std::bad_alloc();
+                    madvise(ptr, size, MADV_HUGEPAGE); // it's only a hint
+                    if constexpr (Prefault)
+                        Populate(ptr, size);
+                    return ptr;
+                }
+            }
+            size = RoundUp(size, sysconf(_SC_PAGESIZE));
+            char* ptr = Map(size, populate);
+            if (!ptr) throw std::bad_alloc();
+            return ptr;
+        }
+        static void DeAllocate(char* ptr, const size_t size) noexcept {
+            munmap(ptr, size);
+        }
+    };
+}
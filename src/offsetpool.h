@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+ * Arena addressed by 32-bit offsets (Linux)
+ *  1. A contiguous virtual range is reserved up front (PROT_NONE, no swap reservation),
+ *     pages are committed on demand in CommitSize chunks, so the base never moves
+ *  2. Allocate() returns an offset in Granularity units: a ui32 covers 4G * Granularity bytes
+ *     (32G for the default 8), the translation is base + (offset << log2(Granularity))
+ *  3. Offset 0 is never allocated and serves as the null handle
+ *  4. Everything is freed at once with the pool, Reset() keeps the committed pages
+ *
+ * Links in compact nodes take 4 bytes instead of 8:
+ *   struct TNode { NMemory::TOffset<TNode> Left, Right; ui32 Key; }; // 12 bytes instead of 24
+ *   NMemory::TOffsetPool<> pool;
+ *   NMemory::TOffset<TNode> n = pool.Emplace<TNode>();
+ *   pool[n].Key = 42;
+ * P.S. destructors aren't called here: the arena is for trivially destructible nodes
+ */
+
+#include "defines.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <sys/mman.h>
+
+
+namespace NMemory {
+    template<typename T>
+    struct TOffset {
+        ui32 Value = 0;
+
+        explicit operator bool() const noexcept { return Value != 0; }
+        bool operator==(const TOffset&) const noexcept = default;
+    };
+
+    template<size_t Granularity = 8>
+    class TOffsetPool {
+    private:
+        static_assert(std::has_single_bit(Granularity), "Granularity must be a power of two");
+        static constexpr size_t Shift = std::countr_zero(Granularity);
+        static constexpr size_t CommitSize = 1 << 20;
+    public:
+        static constexpr size_t MaxCapacity = (size_t(1) << 32) * Granularity;
+    private:
+        char* Base;
+        const size_t Capacity;
+        size_t Committed = 0;
+        size_t Occupied = Granularity; // offset 0 is null
+    private:
+        static size_t RoundUp(const size_t size, const size_t align) noexcept {
+            return (size + align - 1) & ~(align - 1);
+        }
+        void Commit(const size_t end) {
+            size_t size = std::min(RoundUp(end, CommitSize), Capacity) - Committed;
+            if (mprotect(Base + Committed, size, PROT_READ | PROT_WRITE) != 0)
+                throw std::bad_alloc();
+            Committed += size;
+        }
+    public:
+        /* 'capacity' is the reserved address space, not memory */
+        TOffsetPool(const size_t capacity = MaxCapacity)
+            : Capacity(RoundUp(std::min(capacity, MaxCapacity), CommitSize))
+        {
+            void* ptr = mmap(nullptr, Capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (ptr == MAP_FAILED)
+                throw std::bad_alloc();
+            Base = static_cast<char*>(ptr);
+        }
+        TOffsetPool(const TOffsetPool&) = delete;
+        TOffsetPool& operator=(const TOffsetPool&) = delete;
+        ~TOffsetPool() {
+            munmap(Base, Capacity);
+        }
+
+        /* 'align' must be a power of two, returns the offset in Granularity units */
+        ui32 Allocate(const size_t size, const size_t align = Granularity) {
+            size_t begin = RoundUp(Occupied, std::max(align, Granularity));
+            size_t end = RoundUp(begin + size, Granularity);
+            if (end > Capacity)
+                throw std::bad_alloc();
+            if (end > Committed)
+                Commit(end);
+            Occupied = end;
+            return static_cast<ui32>(begin >> Shift);
+        }
+        template<typename T, typename ...Args>
+        TOffset<T> Emplace(Args&&... args) {
+            static_assert(std::is_trivially_destructible_v<T>, "TOffsetPool doesn't call destructors");
+            ui32 offset = Allocate(sizeof(T), alignof(T));
+            new (Ptr(offset)) T(std::forward<Args>(args)...);
+            return TOffset<T>{offset};
+        }
+
+        void* Ptr(const ui32 offset) const noexcept {
+            return Base + (size_t(offset) << Shift);
+        }
+        template<typename T>
+        T* Get(const TOffset<T> offset) const noexcept {
+            return static_cast<T*>(Ptr(offset.Value));
+        }
+        template<typename T>
+        T& operator[](const TOffset<T> offset) const noexcept {
+            return *Get(offset);
+        }
+        /* the inverse translation for a pointer from this pool */
+        template<typename T>
+        TOffset<T> OffsetOf(const T* ptr) const noexcept {
+            return TOffset<T>{static_cast<ui32>((reinterpret_cast<const char*>(ptr) - Base) >> Shift)};
+        }
+
+        void Reset() noexcept {
+            Occupied = Granularity;
+        }
+        size_t Size() const noexcept { return Occupied; }
+        size_t CommittedBytes() const noexcept { return Committed; }
+        size_t CapacityBytes() const noexcept { return Capacity; }
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * std::pmr::memory_resource on top of NMemory::TPool
+ *  1. Small requests are bump allocated from the pool, deallocation is a no-op
+ *  2. Requests bigger than LargeSize (e.g. the growing buffer of a big vector) go to
+ *     the upstream resource and are really freed on deallocation
+ *  3. Everything from the pool is freed at once with the resource: O(blocks)
+ *
+ *   NMemory::TPoolResource<> arena;
+ *   NPrefix::NPmr::TTree tree(&arena);
+ *   // ... fill tree, use it, destroy tree, and then the arena
+ */
+
+#include "mempool.h"
+#include <algorithm>
+#include <memory_resource>
+
+
+namespace NMemory {
+    template<typename TPoolType = TPool<TExponentialStrategy>>
+    class TPoolResource : public std::pmr::memory_resource {
+    private:
+        static constexpr size_t DefaultBlockSize = 1 << 16;
+        static constexpr size_t DefaultLargeSize = 1 << 12;
+
+        TPoolType P;
+        size_t LargeSize;
+        std::pmr::memory_resource* Upstream;
+        size_t UpstreamBytes = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t align) override {
+            if (bytes > LargeSize) {
+                void* ptr = Upstream->allocate(bytes, align);
+                UpstreamBytes += bytes;
+                return ptr;
+            }
+            return P.Allocate(bytes, align);
+        }
+        void do_deallocate(void* ptr, size_t bytes, size_t align) override {
+            if (bytes > LargeSize) {
+                Upstream->deallocate(ptr, bytes, align);
+                UpstreamBytes -= bytes;
+            }
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    public:
+        TPoolResource(const size_t blockSize = DefaultBlockSize,
+                      const size_t largeSize = DefaultLargeSize,
+                      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : P(blockSize)
+            , LargeSize(std::min(largeSize, blockSize / 2)) // a large request must fit into a block
+            , Upstream(upstream)
+        {}
+        TPoolType& Pool() noexcept { return P; }
+        const TPoolType& Pool() const noexcept { return P; }
+        /* pool statistics, large requests which are alive now are added to Reserved */
+        TStats Stats() const noexcept {
+            TStats s = P.Stats();
+            s.Reserved += UpstreamBytes;
+            return s;
+        }
+    };
+}
@@ -3,7 +3,8 @@
 #include <iomanip>
 
 namespace NPrefix {
-    ui8 TDfa::DoXLAT(ui8 symbol) noexcept {
+    template<typename TAllocator>
+    ui8 TBasicDfa<TAllocator>::DoXLAT(ui8 symbol) noexcept {
         if (HAS_XLAT[symbol])
             return XLAT[symbol];
         ui8 id = NextId++;
@@ -11,13 +12,15 @@ namespace NPrefix {
         HAS_XLAT[symbol] = 1;
         return id;
     }
-    ui32 TDfa::GetNextState() noexcept {
+    template<typename TAllocator>
+    ui32 TBasicDfa<TAllocator>::GetNextState() noexcept {
         if (F.empty())
             return NextState++;
         ui32 next = F.back(); F.pop_back();
         return next;
     }
-    void TDfa::UnfoldStateHistory(TStateHistory& sH) {
+    template<typename TAllocator>
+    void TBasicDfa<TAllocator>::UnfoldStateHistory(TStateHistory& sH) {
         // 1. remove HAS_WORD entry if it's a leaf
         TVisit v = sH.back(); sH.pop_back();
         M[v.CurState][v.CurId] = EMPTY;
@@ -42,16 +45,19 @@ namespace NPrefix {
         // 3. crutch: initial empty state shouldn't be available in the list of states
         if (F.back() == EMPTY) F.pop_back();
     }
-    void TDfa::ExpandSV(TStates& sv, ui16 id) {
+    template<typename TAllocator>
+    void TBasicDfa<TAllocator>::ExpandSV(TStates& sv, ui16 id) {
         if (sv.size() <= id)
             sv.resize(id+1, EMPTY);
     }
-    void TDfa::ExpandM(TMatrix& m, ui32 newState) {
+    template<typename TAllocator>
+    void TBasicDfa<TAllocator>::ExpandM(TMatrix& m, ui32 newState) {
         if (m.size() <= newState)
-            m.resize(newState+1, TStates(1, EMPTY));
+            m.resize(newState+1, TStates(1, EMPTY, m.get_allocator()));
     }
 
-    bool TDfa::insert(const std::string& x) {
+    template<typename TAllocator>
+    bool TBasicDfa<TAllocator>::insert(const std::string& x) {
         ui32 curState = EMPTY;
         for(char c: x) {
             ui16 id = DoXLAT(static_cast<ui8>(c))+1;
@@ -75,7 +81,8 @@ namespace NPrefix {
         end = HAS_WORD; Size += r;
         return r;
     }
-    bool TDfa::exists(const std::string& x) const noexcept {
+    template<typename TAllocator>
+    bool TBasicDfa<TAllocator>::exists(const std::string& x) const noexcept {
         ui32 curState = EMPTY;
         for(char c: x) {
             ui8 symbol = static_cast<ui8>(c);
@@ -91,7 +98,8 @@ namespace NPrefix {
         }
         return M[curState][FinalSymbol] == HAS_WORD;
     }
-    bool TDfa::erase(const std::string& x) noexcept {
+    template<typename TAllocator>
+    bool TBasicDfa<TAllocator>::erase(const std::string& x) noexcept {
         TStateHistory sH; // state history
         ui32 curState = EMPTY;
         for(char c: x) {
@@ -112,9 +120,11 @@ namespace NPrefix {
 
         //we have the word: unfolding state history
         sH.push_back({curState, FinalSymbol});
-        UnfoldStateHistory(sH); return true;
+        UnfoldStateHistory(sH); --Size;
+        return true;
     }
-    void TDfa::DebugPrint() const noexcept {
+    template<typename TAllocator>
+    void TBasicDfa<TAllocator>::DebugPrint() const noexcept {
         ui8 RXLAT[AlphabetSize];
         ui16 RLen = 0;
         for(ui16 symbol=0; symbol<AlphabetSize; ++symbol)
@@ -139,4 +149,7 @@ namespace NPrefix {
         for(ui32 state: F) std::cout << ' ' << state;
         std::cout << '\n';
     }
+
+    template class TBasicDfa<std::allocator<char>>;
+    template class TBasicDfa<std::pmr::polymorphic_allocator<char>>;
 }
\ No newline at end of file
@@ -18,6 +18,8 @@
 
 
 #include "defines.h"
+#include <memory>
+#include <memory_resource>
 #include <vector>
 #include <string>
 
@@ -27,15 +29,22 @@ namespace NPrefix {
         HAS_WORD = 1,
     };
 
-    using TMatrix = std::vector<std::vector<ui32>>;
-    using TStates = std::vector<ui32>;
     struct TVisit {
         ui32 CurState;
         ui32 CurId;
     };
     using TStateHistory = std::vector<TVisit>;
 
-    class TDfa {
+    /* TAllocator is an allocator of char: std::allocator<char> or std::pmr::polymorphic_allocator<char>,
+     * it's rebound for the rows and the matrix
+     */
+    template<typename TAllocator>
+    class TBasicDfa {
+    public:
+        template<typename T>
+        using TRebind = typename std::allocator_traits<TAllocator>::template rebind_alloc<T>;
+        using TStates = std::vector<ui32, TRebind<ui32>>;
+        using TMatrix = std::vector<TStates, TRebind<TStates>>;
     private:
         ui8 NextId = 0;
         ui32 NextState = EMPTY + 1;
@@ -57,8 +66,9 @@ namespace NPrefix {
         void ExpandSV(TStates& sv, ui16 id);
         void ExpandM(TMatrix& m, ui32 newState);
     public:
-        TDfa()
-            : M(DefaultSize, TStates(1, EMPTY))
+        TBasicDfa(const TAllocator& a = TAllocator())
+            : F(a)
+            , M(DefaultSize, TStates(1, EMPTY, a), a)
         {}
         bool insert(const std::string& x);
         bool exists(const std::string& x) const noexcept;
@@ -68,4 +78,12 @@ namespace NPrefix {
 
         void DebugPrint() const noexcept;
     };
+
+    using TDfa = TBasicDfa<std::allocator<char>>;
+    using TMatrix = TDfa::TMatrix;
+    using TStates = TDfa::TStates;
+
+    namespace NPmr {
+        using TDfa = TBasicDfa<std::pmr::polymorphic_allocator<char>>;
+    }
 }
\ No newline at end of file
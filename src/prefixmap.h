@@ -0,0 +1,131 @@
+#pragma once
+
+/*
+ *  String -> value map on NPrefix::TBasicTree
+ *  1. The value lives in the '\0'-terminated leaf edge in place of the child link
+ *     (a leaf has no child), so a key is stored once and found by one descent
+ *  2. TValue is trivially copyable and fits 8 bytes: ids, counters, small structs,
+ *     bigger values are kept elsewhere by such an id
+ *  3. Find() returns a copy of the value, Update() changes it in place
+ *   NPrefix::TMap<ui32> map;
+ *   map.Insert("abc", 1);
+ *   map.Upsert("abc", 2);
+ *   map.Update("abc", [](ui32& v) { ++v; });
+ *   if (auto v = map.Find("abc")) ...
+ *   if (auto route = map.LongestPrefixOf("abcd")) // {"abc", 3}
+ *   for(auto it=map.KeysWithPrefix("ab");it;++it)
+ *       std::cout << it.Key() << '=' << it.Value() << '\n';
+ */
+
+#include "prefixtree.h"
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+
+namespace NPrefix {
+    template<typename TValue, typename TAllocator = std::allocator<char>>
+    class TBasicMap {
+    private:
+        static_assert(std::is_trivially_copyable_v<TValue> && sizeof(TValue) <= sizeof(ui64),
+                      "TValue is kept in 8 bytes of a leaf");
+        using TTree = TBasicTree<TAllocator>;
+
+        TTree Tree;
+    private:
+        static ui64 Pack(const TValue& value) noexcept {
+            ui64 payload = 0;
+            std::memcpy(&payload, &value, sizeof(TValue));
+            return payload;
+        }
+        static TValue Unpack(const ui64 payload) noexcept {
+            alignas(TValue) char value[sizeof(TValue)];
+            std::memcpy(value, &payload, sizeof(TValue));
+            return *std::launder(reinterpret_cast<TValue*>(value));
+        }
+        static std::string_view Terminated(const std::string& key) noexcept {
+            return std::string_view(key.c_str(), key.size() + 1); // '\0' too
+        }
+    public:
+        class TIterator {
+        private:
+            typename TTree::TCursor C;
+        public:
+            TIterator(typename TTree::TCursor&& c)
+                : C(std::move(c))
+            {}
+            std::string_view Key() const noexcept { return C.Key(); }
+            TValue Value() const noexcept { return Unpack(C.Payload()); }
+            operator bool() const noexcept { return bool(C); }
+            TIterator& operator ++() noexcept {
+                ++C;
+                return *this;
+            }
+        };
+    public:
+        TBasicMap(const TAllocator& a = TAllocator())
+            : Tree(a)
+        {}
+        /* false if the key is there already, its value is kept */
+        bool Insert(const std::string& key, const TValue& value) {
+            auto [leaf, fresh] = Tree.AppendLeaf(Terminated(key));
+            if (fresh)
+                leaf->Payload = Pack(value);
+            return fresh;
+        }
+        /* true if the key is new, otherwise its value is replaced */
+        bool Upsert(const std::string& key, const TValue& value) {
+            auto [leaf, fresh] = Tree.AppendLeaf(Terminated(key));
+            leaf->Payload = Pack(value);
+            return fresh;
+        }
+        /* f(TValue&) for the value of the key (a new one is value-initialized), true if the key is new */
+        template<typename TFunc>
+        bool Update(const std::string& key, TFunc&& f) {
+            auto [leaf, fresh] = Tree.AppendLeaf(Terminated(key));
+            TValue value = fresh ? TValue{} : Unpack(leaf->Payload);
+            f(value);
+            leaf->Payload = Pack(value);
+            return fresh;
+        }
+        std::optional<TValue> Find(const std::string& key) const noexcept {
+            if (auto leaf = Tree.FindLeaf(Terminated(key)))
+                return Unpack(leaf->Payload);
+            return std::nullopt;
+        }
+        bool Exists(const std::string& key) const noexcept {
+            return Tree.Exists(key);
+        }
+        /* the longest key which is a prefix of x (as a view of x) with its value: O(|x|) */
+        std::optional<std::pair<std::string_view, TValue>> LongestPrefixOf(std::string_view x) const noexcept {
+            std::optional<std::pair<std::string_view, TValue>> longest;
+            Tree.PrefixLeaves(x, [&](size_t size, const auto& leaf) {
+                longest.emplace(x.substr(0, size), Unpack(leaf.Payload));
+                return true;
+            });
+            return longest;
+        }
+        bool Remove(const std::string& key) {
+            return Tree.Remove(key);
+        }
+        TIterator KeysWithPrefix(std::string_view prefix) const {
+            return Tree.CursorWithPrefix(prefix);
+        }
+        TIterator AllKeys() const {
+            return Tree.CursorWithPrefix(std::string_view());
+        }
+        TIterator LowerBound(std::string_view key) const {
+            return Tree.LowerBound(key);
+        }
+        void clear() noexcept { Tree.clear(); }
+        ui32 size() const noexcept { return Tree.size(); }
+    };
+
+    template<typename TValue>
+    using TMap = TBasicMap<TValue>;
+    namespace NPmr {
+        template<typename TValue>
+        using TMap = TBasicMap<TValue, std::pmr::polymorphic_allocator<char>>;
+    }
+}
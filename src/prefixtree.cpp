@@ -1,8 +1,43 @@
 #include "prefixtree.h"
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <thread>
+#include <immintrin.h>
 
 namespace NPrefix {
+    template<typename TAllocator>
+    size_t TBasicNode<TAllocator>::Find(const char c) const noexcept {
+        const ui8* first = First.data();
+        const size_t n = Keys.size();
+        // first bytes are unique, so the lowest match is the one, matches in the padding are cut off
+#if defined(__AVX2__) && !defined(PREFIX_SCALAR_FIND)
+        const __m256i v = _mm256_set1_epi8(c);
+        for(size_t i=0; i<n; i+=Lane)
+            if (ui32 mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i)))))
+                return std::min(i + __builtin_ctz(mask), n);
+        return n;
+#elif defined(__SSE2__) && !defined(PREFIX_SCALAR_FIND)
+        const __m128i v = _mm_set1_epi8(c);
+        for(size_t i=0; i<n; i+=Lane)
+            if (ui32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i)))))
+                return std::min(i + __builtin_ctz(mask), n);
+        return n;
+#else
+        return std::find(first, first + n, ui8(c)) - first;
+#endif
+    }
+    template<typename TAllocator>
+    size_t TBasicNode<TAllocator>::LowerBound(const char c) const noexcept {
+        return std::lower_bound(First.data(), First.data() + Keys.size(), ui8(c)) - First.data();
+    }
+
     /*
      * x always has '\0' at the end, it's very important here
      *
@@ -22,57 +57,125 @@ namespace NPrefix {
      *   x='ab\0'
      * key='abcde\0'
      */
-    size_t TTree::Prefix(const std::string_view x, const std::string_view key) const noexcept {
+    template<typename TAllocator>
+    size_t TBasicTree<TAllocator>::Prefix(const std::string_view x, const std::string_view key) const noexcept {
         // x always has '\0', key has only in leaf
         for(size_t i=0; i<key.size(); ++i)
             if (key[i] != x[i]) // if (x.size() < key.size()) '\0' in the 'x' must trigger this if
                 return i;
         return key.size();
     }
-    TNode* TTree::Split(TNode::TInner& parent, ui32 i) {
-        TNode* child = new TNode();
-        child->Keys.emplace_back(parent.Key.substr(i), parent.Link);
+    void CheckLabelBytes(const size_t size) {
+        if (size > std::numeric_limits<ui32>::max())
+            throw std::length_error("TTree: the byte pool of labels is full");
+    }
+    template<typename TAllocator>
+    typename TBasicTree<TAllocator>::TInner TBasicTree<TAllocator>::NewInner(std::string_view label, TNode* link) {
+        TInner inner{};
+        inner.Size = label.size();
+        inner.Link = link;
+        if (label.size() <= TInner::ShortSize) {
+            std::memcpy(inner.Short, label.data(), label.size());
+            return inner;
+        }
+        CheckLabelBytes(Bytes.size() + label.size());
+        inner.Offset = Bytes.size();
+        Bytes.insert(Bytes.end(), label.begin(), label.end());
+        return inner;
+    }
+    // [from, from+size) of the label, long labels share the bytes
+    template<typename TAllocator>
+    typename TBasicTree<TAllocator>::TInner TBasicTree<TAllocator>::SubInner(const TInner& inner, size_t from, size_t size) const noexcept {
+        TInner sub = inner;
+        sub.Size = size;
+        if (size <= TInner::ShortSize)
+            std::memcpy(sub.Short, Label(inner).data() + from, size);
+        else
+            sub.Offset = inner.Offset + from;
+        return sub;
+    }
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::Forget(const TInner& inner) noexcept {
+        if (inner.Size > TInner::ShortSize)
+            Garbage += inner.Size;
+    }
+    // copies the live labels into a new pool, shared bytes are copied for each label
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::Compact() {
+        auto forEachLong = [this](auto f) {
+            std::vector<TNode*> todo{&Root};
+            while(!todo.empty()) {
+                TNode* cur = todo.back(); todo.pop_back();
+                for(auto& inner: cur->Keys) {
+                    if (TNode* child = Child(inner)) // the label is read before it's moved
+                        todo.push_back(child);
+                    if (inner.Size > TInner::ShortSize)
+                        f(inner);
+                }
+            }
+        };
+        size_t total = 0;
+        forEachLong([&total](const TInner& inner) { total += inner.Size; });
+        TBytes bytes(A);
+        bytes.reserve(total); // nothing may throw while the offsets are changed
+        forEachLong([this, &bytes](TInner& inner) {
+            const char* b = Bytes.data() + inner.Offset;
+            inner.Offset = bytes.size();
+            bytes.insert(bytes.end(), b, b + inner.Size);
+        });
+        Bytes.swap(bytes);
+        Garbage = 0;
+    }
+    template<typename TAllocator>
+    typename TBasicTree<TAllocator>::TNode* TBasicTree<TAllocator>::NewNode() {
+        TNodeAllocator a(A);
+        TNode* node = std::allocator_traits<TNodeAllocator>::allocate(a, 1);
+        std::allocator_traits<TNodeAllocator>::construct(a, node, A);
+        return node;
+    }
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::DeleteNode(TNode* node) noexcept {
+        TNodeAllocator a(A);
+        std::allocator_traits<TNodeAllocator>::destroy(a, node);
+        std::allocator_traits<TNodeAllocator>::deallocate(a, node, 1);
+    }
+    template<typename TAllocator>
+    typename TBasicTree<TAllocator>::TNode* TBasicTree<TAllocator>::Split(TInner& parent, ui32 i) {
+        TNode* child = NewNode();
+        child->Emplace(0, SubInner(parent, i, parent.Size - i), Label(parent)[i]);
 
-        parent.Key.resize(i); // there's no explicit '\0' any more here
-        parent.Key.shrink_to_fit(); // I want to fit into SSO whenever it's possible
+        parent = SubInner(parent, 0, i); // there's no explicit '\0' any more here
         parent.Link = child;
         return child;
     }
 
-    struct TInnerFirstLetterCmp {
-        bool operator ()(const TNode::TInner& lhs, const std::string_view& rhs) const noexcept {
-            return lhs.Key.front() < rhs.front();
-        }
-        bool operator ()(const std::string_view& lhs, const TNode::TInner& rhs) const noexcept {
-            return lhs.front() < rhs.Key.front();
-        }
-    };
-
-    bool TTree::AppendStrView(std::string_view x) {
+    template<typename TAllocator>
+    std::pair<typename TBasicTree<TAllocator>::TInner*, bool> TBasicTree<TAllocator>::AppendLeaf(std::string_view x) {
         if (Root.Keys.empty()) {
-            Root.Keys.emplace_back(x);
-            ++Size; return true;
+            TInner& leaf = Root.Emplace(0, NewInner(x), x.front());
+            ++Size; return {&leaf, true};
         }
 
         TNode* cur = &Root;
         while(true) {
             auto& keys = cur->Keys;
             // main strength is here - O(log n) access via first letter => R-way compressed trie
-            auto it = std::lower_bound(keys.begin(), keys.end(), x, TInnerFirstLetterCmp());
-            if (it == keys.end()) {
-                keys.emplace_back(x); ++Size;
-                return true;
+            size_t pos = cur->LowerBound(x.front());
+            if (pos == keys.size()) {
+                TInner& leaf = cur->Emplace(pos, NewInner(x), x.front()); ++Size;
+                return {&leaf, true};
             }
-            std::string_view key = it->Key;
+            auto it = keys.begin() + pos;
+            std::string_view key = Label(*it);
             ui32 i = Prefix(x, key);
             if (i == 0) {
-                // main weakness is here - O(n) insert in a vector
-                keys.emplace(it, x); ++Size;
-                return true;
+                // main weakness is here - O(n) insert in a vector (of 16 byte edges)
+                TInner& leaf = cur->Emplace(pos, NewInner(x), x.front()); ++Size;
+                return {&leaf, true};
             }
             if (i == x.size()) {
                 // case 2 -> x is already in the tree
-                return false;
+                return {&*it, false};
             }
             if (i == key.size()) {
                 // case 1 -> key is a prefix of the x
@@ -85,54 +188,353 @@ namespace NPrefix {
             cur = Split(*it, i);
         }
     }
-    bool TTree::ExistsStrView(std::string_view x) const noexcept {
+    /*
+     * The keys come in order, so only the rightmost path may change: the new key x shares
+     * l = LCP(prev, x) bytes with the previous one, the path is cut to the node at depth <= l,
+     * its last edge is split at l if it goes deeper, and x[l..] is appended as the last edge
+     */
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::BuildNext(TBuildState& state, std::string_view key) {
+        state.Cur.assign(key);
+        state.Cur.push_back('\0');
+        std::string_view x = state.Cur;
+        if (Size == 0) {
+            Root.Emplace(0, NewInner(x), x.front());
+            ++Size; state.Prev.swap(state.Cur);
+            return;
+        }
+        std::string_view prev = state.Prev;
+        size_t l = 0;
+        while(l < prev.size() && prev[l] == x[l]) // both have '\0' in the end
+            ++l;
+        if (l == prev.size()) // a duplicate
+            return;
+        if (ui8(x[l]) < ui8(prev[l])) {
+            clear();
+            throw std::invalid_argument("TTree: keys aren't sorted");
+        }
+
+        auto& path = state.Path;
+        while(path.back().second > l)
+            path.pop_back();
+        auto [node, depth] = path.back();
+        if (depth < l) { // the last edge goes deeper than l, otherwise its node would be on the path
+            node = Split(node->Keys.back(), l - depth);
+            path.emplace_back(node, l);
+        }
+        node->Emplace(node->Keys.size(), NewInner(x.substr(l)), x[l]);
+        ++Size; state.Prev.swap(state.Cur);
+    }
+
+    namespace {
+        // the byte at d with the end of the key below any byte
+        inline ui32 ByteAt(std::string_view s, size_t d) noexcept {
+            return d < s.size() ? ui8(s[d]) + 1 : 0;
+        }
+        // multikey quicksort: a three-way partition by the byte at d, the middle part goes to d+1
+        void MultikeySort(TKeyRefs::iterator b, TKeyRefs::iterator e, size_t d) {
+            while(e - b > 16) {
+                const ui32 pivot = ByteAt(b[(e - b) / 2], d);
+                auto lt = b, i = b, gt = e;
+                while(i < gt) {
+                    const ui32 c = ByteAt(*i, d);
+                    if (c < pivot)
+                        std::iter_swap(lt++, i++);
+                    else if (c > pivot)
+                        std::iter_swap(i, --gt);
+                    else
+                        ++i;
+                }
+                MultikeySort(b, lt, d);
+                MultikeySort(gt, e, d);
+                if (pivot == 0) // equal keys
+                    return;
+                b = lt; e = gt; ++d;
+            }
+            std::sort(b, e, [d](std::string_view x, std::string_view y) {
+                return x.substr(d) < y.substr(d);
+            });
+        }
+        // bucket i = [bounds[i], bounds[i+1]) is keys with ByteAt(key, 0) == i: 0 for empty keys
+        std::vector<size_t> PartitionByFirstByte(TKeyRefs& keys) {
+            std::vector<size_t> bounds(258);
+            for(auto key: keys)
+                ++bounds[ByteAt(key, 0) + 1];
+            for(ui32 i=1; i<bounds.size(); ++i)
+                bounds[i] += bounds[i-1];
+            TKeyRefs sorted(keys.size());
+            std::vector<size_t> pos(bounds.begin(), bounds.end() - 1);
+            for(auto key: keys)
+                sorted[pos[ByteAt(key, 0)]++] = key;
+            keys.swap(sorted);
+            return bounds;
+        }
+        // job(j) for j in [0, count) on up to 'threads' threads (the caller is one of them),
+        // the first exception of a job is rethrown
+        template<typename TJob>
+        void RunJobs(const ui32 threads, const ui32 count, TJob&& job) {
+            std::atomic<ui32> next = 0;
+            std::vector<std::exception_ptr> errors(threads);
+            auto work = [&](const ui32 t) {
+                try {
+                    for(ui32 j; (j = next++) < count;)
+                        job(j);
+                } catch(...) {
+                    errors[t] = std::current_exception();
+                    next = count;
+                }
+            };
+            std::vector<std::thread> workers;
+            try {
+                workers.reserve(threads);
+                for(ui32 t=1; t<threads; ++t)
+                    workers.emplace_back(work, t);
+            } catch(...) {
+                // fewer threads: the caller takes the rest of the jobs
+            }
+            work(0);
+            for(auto& w: workers)
+                w.join();
+            for(const auto& e: errors)
+                if (e)
+                    std::rethrow_exception(e);
+        }
+    }
+
+    /*
+     * Keys are spread into buckets by the first byte, the buckets are independent
+     * (no merge afterwards) and 'threads' workers take them, the largest first
+     */
+    void ParallelSort(TKeyRefs& keys, ui32 threads) {
+        threads = std::max(1U, std::min<ui32>(threads, keys.size() / (1 << 12)));
+        if (threads == 1) {
+            MultikeySort(keys.begin(), keys.end(), 0);
+            return;
+        }
+        const std::vector<size_t> bounds = PartitionByFirstByte(keys);
+
+        std::vector<ui32> order;
+        for(ui32 i=1; i+1<bounds.size(); ++i) // bucket 0 is empty keys, nothing to sort
+            if (bounds[i+1] - bounds[i] > 1)
+                order.push_back(i);
+        std::sort(order.begin(), order.end(), [&bounds](ui32 x, ui32 y) {
+            return bounds[x+1] - bounds[x] > bounds[y+1] - bounds[y];
+        });
+        std::atomic<ui32> next = 0;
+        std::vector<std::thread> workers;
+        for(ui32 i=0; i<threads; ++i)
+            workers.emplace_back([&]() {
+                for(ui32 j; (j = next++) < order.size();)
+                    MultikeySort(keys.begin() + bounds[order[j]], keys.begin() + bounds[order[j]+1], 1);
+            });
+        for(auto& w: workers)
+            w.join();
+    }
+
+    /*
+     * Each bucket of the first byte is sorted and built into a tree of its own (its nodes and
+     * its label pool), a tree of one bucket has one edge in its root. The edges are moved into
+     * Root in the byte order, then the label pools are copied into Bytes one after another and
+     * the offsets of long labels are shifted by the start of their pool, the threads share nothing
+     * but the allocator (the second pass writes to disjoint parts of Bytes and Root.Keys)
+     */
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::BuildParallelRefs(TKeyRefs& keys, ui32 threads) {
+        clear();
+        threads = std::max(1U, std::min<ui32>(threads, keys.size() / (1 << 12)));
+        const std::vector<size_t> bounds = PartitionByFirstByte(keys);
+        std::vector<ui32> order; // non-empty buckets, the largest first
+        for(ui32 i=0; i+1<bounds.size(); ++i)
+            if (bounds[i+1] > bounds[i])
+                order.push_back(i);
+        std::sort(order.begin(), order.end(), [&bounds](ui32 x, ui32 y) {
+            return bounds[x+1] - bounds[x] > bounds[y+1] - bounds[y];
+        });
+        std::vector<std::unique_ptr<TBasicTree>> parts(bounds.size() - 1);
+        std::vector<TPath> paths(parts.size());
+        for(ui32 i: order)
+            parts[i] = std::make_unique<TBasicTree>(A);
+        RunJobs(threads, order.size(), [&](const ui32 j) {
+            const ui32 i = order[j];
+            const auto b = keys.begin() + bounds[i], e = keys.begin() + bounds[i+1];
+            if (i != 0) // bucket 0 is empty keys
+                MultikeySort(b, e, 1);
+            parts[i]->BuildFromSorted(std::ranges::subrange(b, e));
+            size_t depth = 0; // a node below the root is at least one byte deeper than its parent
+            for(auto it=b; it!=e; ++it)
+                depth = std::max(depth, it->size());
+            paths[i].reserve(depth + 1);
+        });
+
+        std::vector<size_t> bases(parts.size());
+        size_t bytes = 0;
+        for(ui32 i=0; i<parts.size(); ++i)
+            if (parts[i]) {
+                bases[i] = bytes;
+                bytes += parts[i]->Bytes.size();
+            }
+        CheckLabelBytes(bytes); // the shifted offsets must not wrap
+        Bytes.resize(bytes);
+        Root.Keys.reserve(order.size());
+        Root.First.reserve(order.size() + TNode::Lane);
+        // everything is allocated: nothing below throws, the parts own their nodes until they are moved
+        RunJobs(threads, order.size(), [&](const ui32 j) noexcept {
+            TBasicTree& part = *parts[order[j]];
+            std::copy(part.Bytes.begin(), part.Bytes.end(), Bytes.begin() + bases[order[j]]);
+            part.ShiftOffsets(part.Root.Keys.front(), bases[order[j]], paths[order[j]]);
+        });
+        for(ui32 i=0; i<parts.size(); ++i)
+            if (parts[i]) {
+                TBasicTree& part = *parts[i];
+                Root.Emplace(Root.Keys.size(), part.Root.Keys.front(), char(i == 0 ? 0 : i - 1));
+                Size += part.Size;
+                Garbage += part.Garbage;
+                part.Root.Clear(); // the nodes belong to the tree now
+                part.Size = 0;
+            }
+    }
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::ShiftOffsets(TInner& edge, const size_t base, TPath& path) noexcept {
+        auto shift = [this, base, &path](TInner& inner) {
+            if (TNode* child = Child(inner)) // the label is read before it's shifted
+                path.emplace_back(child, 0);
+            if (inner.Size > TInner::ShortSize)
+                inner.Offset += base;
+        };
+        shift(edge);
+        while(!path.empty()) {
+            auto& [node, next] = path.back();
+            if (next == node->Keys.size())
+                path.pop_back();
+            else
+                shift(node->Keys[next++]);
+        }
+    }
+
+    template<typename TAllocator>
+    const typename TBasicTree<TAllocator>::TInner* TBasicTree<TAllocator>::FindLeaf(std::string_view x) const noexcept {
         const TNode* cur = &Root;
         while(true) {
             auto& keys = cur->Keys;
-            auto it = std::lower_bound(keys.begin(), keys.end(), x, TInnerFirstLetterCmp());
-            if (it == keys.end()) return false;
+            size_t pos = cur->Find(x.front());
+            if (pos == keys.size()) return nullptr;
 
-            std::string_view key = it->Key;
+            std::string_view key = Label(keys[pos]);
             ui32 i = Prefix(x, key);
-            if (i == 0) return false;
-            if (i == x.size()) return true; // case 2 -> full match
+            if (i == x.size()) return &keys[pos]; // case 2 -> full match
             if (i == key.size()) {
                 // case 1 -> key is a prefix of the x
                 x.remove_prefix(i);
-                cur = it->Link;
+                cur = keys[pos].Link;
                 continue;
             }
             // case 3,4 -> i < key.size()
-            return false;
+            return nullptr;
         }
     }
-    void TTree::Join(TNode* cur, TKeyIt parent) {
+    /*
+     * A descent is a chain of dependent loads per level: the node, its first bytes, the edge,
+     * the long label. The lookups of a group go down in rounds of one level, a round is a pass
+     * over the group per load, each pass prefetches what the next one reads, so the misses of
+     * the group overlap (group prefetching); a finished lookup gives its place to the next key
+     * before the next round
+     */
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::ExistsBatch(std::span<const std::string_view> keys, std::span<bool> found) const noexcept {
+        assert(found.size() >= keys.size());
+        struct TLookup {
+            const TNode* Node;
+            const TInner* Edge;
+            size_t Key;
+            size_t Pos; // matched bytes of the key
+        };
+        constexpr size_t Group = 16;
+        TLookup group[Group];
+        size_t active = 0;
+        for(size_t next=0; next < keys.size() || active > 0;) {
+            for(; active < Group && next < keys.size(); ++next) {
+                if (next + Group < keys.size()) // the bytes of the keys are misses too
+                    __builtin_prefetch(keys[next + Group].data());
+                group[active++] = {&Root, nullptr, next, 0};
+            }
+            for(size_t g=0; g<active; ++g)
+                __builtin_prefetch(group[g].Node->First.data());
+            for(size_t g=0; g<active; ++g) {
+                TLookup& l = group[g];
+                const std::string_view x = keys[l.Key];
+                const size_t pos = l.Node->Find(l.Pos < x.size() ? x[l.Pos] : '\0');
+                l.Edge = pos < l.Node->Keys.size() ? l.Node->Keys.data() + pos : nullptr;
+                __builtin_prefetch(l.Edge);
+            }
+            for(size_t g=0; g<active; ++g)
+                if (const TInner* edge = group[g].Edge; edge && edge->Size > TInner::ShortSize)
+                    __builtin_prefetch(Bytes.data() + edge->Offset);
+            for(size_t g=0; g<active;) {
+                TLookup& l = group[g];
+                const std::string_view x = keys[l.Key];
+                bool done = !l.Edge;
+                if (!done) {
+                    const std::string_view label = Label(*l.Edge);
+                    const size_t rest = x.size() - l.Pos;
+                    if (label.back() == '\0') { // the rest of the key and '\0'
+                        found[l.Key] = label.size() - 1 == rest && std::memcmp(label.data(), x.data() + l.Pos, rest) == 0;
+                        done = true;
+                    } else if (rest < label.size() || std::memcmp(label.data(), x.data() + l.Pos, label.size()) != 0) {
+                        found[l.Key] = false;
+                        done = true;
+                    } else {
+                        l.Pos += label.size();
+                        l.Node = l.Edge->Link;
+                        __builtin_prefetch(l.Node);
+                    }
+                } else {
+                    found[l.Key] = false;
+                }
+                if (done)
+                    l = group[--active]; // g is taken by the last one
+                else
+                    ++g;
+            }
+        }
+    }
+
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::Join(TNode* cur, TKeyIt parent) {
         if (cur == &Root) // for Root everything is permitted
             return;
         auto& keys = cur->Keys;
         // minimum number of keys is always 2, and we've just removed one
         if (keys.size() != 1) // >=2 left, nothing is needed
             return;
-        TNode::TInner& child = keys.front();
-        parent->Key += child.Key;
-        parent->Link = nullptr;
-        delete cur;
+        auto& child = keys.front();
+        std::string label(Label(*parent));
+        label += Label(child);
+        TInner joined = NewInner(label);
+        joined.Payload = child.Payload; // the child may have a subtree or a value
+        Forget(*parent); Forget(child);
+        *parent = joined;
+        DeleteNode(cur);
     }
-    bool TTree::RemoveStrView(std::string_view x) {
+    template<typename TAllocator>
+    bool TBasicTree<TAllocator>::RemoveStrView(std::string_view x) {
         TNode* cur = &Root;
         TKeyIt prevIt;
         while(true) {
             auto& keys = cur->Keys;
-            auto it = std::lower_bound(keys.begin(), keys.end(), x, TInnerFirstLetterCmp());
-            if (it == keys.end()) return false;
+            size_t pos = cur->Find(x.front());
+            if (pos == keys.size()) return false;
 
-            std::string_view key = it->Key;
+            auto it = keys.begin() + pos;
+            std::string_view key = Label(*it);
             ui32 i = Prefix(x, key);
-            if (i == 0) return false;
             if (i == x.size()) {
                 // case 2 -> full match
-                keys.erase(it); Join(cur, prevIt);
-                --Size; return true;
+                Forget(*it);
+                cur->Erase(pos); Join(cur, prevIt);
+                --Size;
+                if (Garbage > (1 << 12) && Garbage > Bytes.size() / 2)
+                    Compact();
+                return true;
             }
             if (i == key.size()) {
                 // case 1 -> key is a prefix of the x
@@ -145,22 +547,26 @@ namespace NPrefix {
             return false;
         }
     }
-    void TTree::clear() noexcept {
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::clear() noexcept {
         std::vector<TNode*> todo;
         for (auto& inner: Root.Keys)
-            if (inner.Link) todo.push_back(inner.Link);
+            if (TNode* child = Child(inner)) todo.push_back(child);
         while(!todo.empty()) {
             TNode* cur = todo.back(); todo.pop_back();
             for(auto& inner: cur->Keys)
-                if (inner.Link)
-                    todo.push_back(inner.Link);
-            delete cur;
+                if (TNode* child = Child(inner))
+                    todo.push_back(child);
+            DeleteNode(cur);
         }
-        Root.Keys.clear();
+        Root.Clear();
+        Bytes.clear();
+        Garbage = 0;
+        Size = 0;
     }
 
+    template<typename TIt>
     struct TWithLevel {
-        using TIt = TCKeyIt;
         TIt CurIt;
         TIt EndIt;
         ui32 L;
@@ -171,33 +577,113 @@ namespace NPrefix {
         {}
     };
 
-    template<typename F>
-    void InOrderTraverse(const TNode& root, F visit) {
+    // child(inner) is the child node or nullptr for a leaf
+    template<typename TNode, typename C, typename F>
+    void InOrderTraverse(const TNode& root, C child, F visit) {
         if (root.Keys.empty()) return;
-        std::vector<TWithLevel> todo; todo.emplace_back(root.Keys.begin(), root.Keys.end(), 1);
+        std::vector<TWithLevel<typename TNode::TKeys::const_iterator>> todo; todo.emplace_back(root.Keys.begin(), root.Keys.end(), 1);
         while(!todo.empty()) {
             auto wl = todo.back(); todo.pop_back();
             auto nextCurIt = wl.CurIt; ++nextCurIt;
             if (nextCurIt != wl.EndIt)
                 todo.emplace_back(nextCurIt, wl.EndIt, wl.L);
-            if (wl.CurIt->Link)
-                todo.emplace_back(wl.CurIt->Link->Keys.begin(), wl.CurIt->Link->Keys.end(), wl.L+1);
+            if (const TNode* next = child(*wl.CurIt))
+                todo.emplace_back(next->Keys.begin(), next->Keys.end(), wl.L+1);
             visit(wl);
         }
     }
 
-    TKeyRefs TTree::InOrder() const noexcept {
+    template<typename TAllocator>
+    TKeyRefs TBasicTree<TAllocator>::InOrder() const noexcept {
         TKeyRefs refs;
-        InOrderTraverse(Root, [&refs](const TWithLevel& wl){
-            refs.push_back(wl.CurIt->Key);
+        InOrderTraverse(Root, [this](const TInner& inner) { return Child(inner); }, [this, &refs](const auto& wl){
+            refs.push_back(Label(*wl.CurIt));
         });
         return refs;
     }
-    void TTree::DebugPrint() const noexcept {
+    /*
+     * Depth-first with a Levenshtein DP row per byte of the key: rows[d][j] is the distance
+     * between key[0, d) and query[0, j), a row is computed from the previous one only,
+     * so a step down an edge appends a row and a step back truncates the rows.
+     * Only the band |j - d| <= maxDistance is computed (the cells out of it are more anyway),
+     * values are capped at maxDistance + 1 which also marks the cells next to the band.
+     * A subtree is skipped as soon as the whole band of a row exceeds maxDistance.
+     */
+    template<typename TAllocator>
+    std::vector<std::pair<std::string, ui32>> TBasicTree<TAllocator>::FuzzySearch(std::string_view query, const ui32 maxDistance) const {
+        std::vector<std::pair<std::string, ui32>> found;
+        const size_t m = query.size();
+        const size_t width = m + 1;
+        const ui32 cap = maxDistance + 1;
+        std::vector<ui32> rows(width, cap);
+        for(size_t j=0; j<=std::min<size_t>(m, maxDistance); ++j)
+            rows[j] = j;
+        std::string key;
+        struct TFrame {
+            const TNode* Node;
+            size_t Next;
+            size_t Depth;
+        };
+        std::vector<TFrame> stack{{&Root, 0, 0}};
+        while(!stack.empty()) {
+            TFrame& top = stack.back();
+            if (top.Next == top.Node->Keys.size()) {
+                stack.pop_back();
+                continue;
+            }
+            const TInner& inner = top.Node->Keys[top.Next++];
+            const size_t depth = top.Depth;
+            const std::string_view label = Label(inner);
+            key.resize(depth);
+            rows.resize((depth + 1) * width);
+            // the bytes of the edge one after another without going back to the stack
+            bool alive = true;
+            for(size_t i=0; alive && i<label.size(); ++i) {
+                const size_t d = depth + i;
+                const char c = label[i];
+                if (c == '\0') { // the end of a leaf: key[0, d) is a key
+                    if (d <= m + maxDistance && m <= d + maxDistance && rows[d * width + m] <= maxDistance)
+                        found.emplace_back(key, rows[d * width + m]);
+                    break;
+                }
+                key.push_back(c);
+                rows.resize((d + 2) * width);
+                const ui32* prev = rows.data() + d * width;
+                ui32* row = rows.data() + (d + 1) * width;
+                const size_t lo = d + 1 > maxDistance ? d + 1 - maxDistance : 0;
+                const size_t hi = std::min(m, d + 1 + maxDistance);
+                if (lo > hi) { // the key is too long for the query already
+                    alive = false;
+                    break;
+                }
+                size_t j = lo;
+                ui32 best = cap;
+                if (j == 0) {
+                    best = row[0] = std::min<ui32>(d + 1, cap);
+                    ++j;
+                } else {
+                    row[j - 1] = cap;
+                }
+                for(; j<=hi; ++j) {
+                    const ui32 v = std::min({prev[j] + 1, row[j - 1] + 1, prev[j - 1] + (query[j - 1] != c), cap});
+                    row[j] = v;
+                    best = std::min(best, v);
+                }
+                if (hi < m)
+                    row[hi + 1] = cap;
+                alive = best <= maxDistance;
+            }
+            if (alive && label.back() != '\0')
+                stack.push_back({inner.Link, 0, depth + label.size()});
+        }
+        return found;
+    }
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::DebugPrint() const noexcept {
         std::cout << "Graph={\n";
-        InOrderTraverse(Root, [](const TWithLevel& wl) {
+        InOrderTraverse(Root, [this](const TInner& inner) { return Child(inner); }, [this](const auto& wl) {
             ui32 l = wl.L; while(l--) std::cout << '-';
-            std::string_view key = wl.CurIt->Key;
+            std::string_view key = Label(*wl.CurIt);
             if (key.back() == '\0') {
                 key.remove_suffix(1);
                 std::cout << key << "$\n";
@@ -206,12 +692,13 @@ namespace NPrefix {
         });
         std::cout << "}\n";
     }
-    void TTree::DebugInfo() const noexcept {
+    template<typename TAllocator>
+    void TBasicTree<TAllocator>::DebugInfo() const noexcept {
         struct TInfo {
             ui32 maxHeight = 0;
             ui32 nodesCount = 0;
         } info;
-        InOrderTraverse(Root, [&info](const TWithLevel& wl){
+        InOrderTraverse(Root, [this](const TInner& inner) { return Child(inner); }, [&info](const auto& wl){
             ++info.nodesCount;
             info.maxHeight = std::max(info.maxHeight, wl.L);
         });
@@ -219,7 +706,8 @@ namespace NPrefix {
     }
 
 
-    TIterator::TIterator(const TTree* tree)
+    template<typename TAllocator>
+    TBasicIterator<TAllocator>::TBasicIterator(const TTree* tree)
         : T(tree)
     {
         if (T->Root.Keys.empty()) return;
@@ -227,26 +715,24 @@ namespace NPrefix {
         GoDownToLeaf(std::string(), T->Root.Keys.begin());
     }
 
-    TIterator::TIterator(std::string_view x, const TTree* tree)
+    template<typename TAllocator>
+    TBasicIterator<TAllocator>::TBasicIterator(std::string_view x, const TTree* tree)
         : T(tree)
     {
         std::string p;
         const TNode* cur = &T->Root;
         while(true) {
             auto& keys = cur->Keys;
-            auto it = std::lower_bound(keys.begin(), keys.end(), x, TInnerFirstLetterCmp());
-            if (it == keys.end()) {
+            size_t pos = cur->Find(x.front());
+            if (pos == keys.size()) {
                 // remain S empty
                 return;
             }
 
-            std::string_view key = it->Key;
+            auto it = keys.begin() + pos;
+            std::string_view key = T->Label(*it);
             // T::Prefix needs x to be null-terminated string
             ui32 i = T->Prefix(x, key);
-            if (i == 0) {
-                // remain S empty
-                return;
-            }
             if (i == x.size()) {
                 // case 2 -> full match
                 GoDownToLeaf(std::move(p), it);
@@ -271,18 +757,21 @@ namespace NPrefix {
         } // while
     }
 
-    void TIterator::GoDownToLeaf(std::string p, TCKeyIt b) {
-        while (b->Link) {
-            auto& childKeys = b->Link->Keys;
-            p.append(b->Key.data(), b->Key.size());
+    template<typename TAllocator>
+    void TBasicIterator<TAllocator>::GoDownToLeaf(std::string p, TCKeyIt b) {
+        while (const TNode* child = T->Child(*b)) {
+            auto& childKeys = child->Keys;
+            p.append(T->Label(*b));
             S.emplace_back(p, childKeys.begin(), childKeys.end());
             b=childKeys.begin();
         }
-        p.append(b->Key.data(), b->Key.size()-1);
+        std::string_view key = T->Label(*b);
+        p.append(key.data(), key.size()-1);
         S.emplace_back(std::move(p), b, b+1); //b,b+1 is a fake end marker here
     }
 
-    TIterator& TIterator::operator ++() noexcept {
+    template<typename TAllocator>
+    TBasicIterator<TAllocator>& TBasicIterator<TAllocator>::operator ++() noexcept {
         while(!S.empty()) {
             auto& top = S.back();
             auto b = top.Begin + 1;
@@ -295,4 +784,111 @@ namespace NPrefix {
         }
         return *this;
     }
+
+    template<typename TAllocator>
+    void TBasicCursor<TAllocator>::Seek(std::string_view prefix) {
+        Limited = false;
+        S.clear();
+        K.clear();
+        if (prefix.empty()) {
+            S.push_back({T->Root.Keys.begin(), T->Root.Keys.end(), 0});
+            Next();
+            return;
+        }
+        const TNode* cur = &T->Root;
+        for(size_t i=0;;) {
+            const size_t pos = cur->Find(prefix[i]);
+            Valid = pos < cur->Keys.size();
+            if (!Valid)
+                return;
+            auto it = cur->Keys.begin() + pos;
+            const std::string_view label = T->Label(*it);
+            const size_t rest = prefix.size() - i;
+            // a label ends with '\0' only in a leaf, the prefix has no '\0': it mismatches there
+            Valid = label.compare(0, std::min(rest, label.size()), prefix.substr(i, label.size())) == 0;
+            if (!Valid)
+                return;
+            if (rest <= label.size()) { // the prefix ends on this edge
+                K.assign(prefix.substr(0, i));
+                S.push_back({it, it + 1, i});
+                Next();
+                return;
+            }
+            i += label.size();
+            cur = it->Link;
+        }
+    }
+
+    /*
+     * Each node on the path of key gets a frame starting at the first edge which may hold
+     * a key >= key (> key for upper), the edge the path goes through is taken as visited
+     */
+    template<typename TAllocator>
+    void TBasicCursor<TAllocator>::SeekBound(std::string_view key, const bool upper) {
+        auto at = [key](const size_t j) -> ui8 { // the implicit '\0' in the end
+            return j < key.size() ? key[j] : 0;
+        };
+        S.clear();
+        const TNode* cur = &T->Root;
+        size_t i = 0;
+        while(true) {
+            const ui8 c = at(i);
+            size_t pos = cur->LowerBound(c);
+            auto it = cur->Keys.begin() + pos;
+            if (pos == cur->Keys.size() || ui8(cur->First[pos]) != c) {
+                S.push_back({it, cur->Keys.end(), i});
+                break;
+            }
+            const std::string_view label = T->Label(*it);
+            size_t p = 1;
+            while(p < label.size() && ui8(label[p]) == at(i + p))
+                ++p;
+            if (p < label.size()) { // the keys of the edge are all less or all greater than key
+                S.push_back({ui8(label[p]) < at(i + p) ? it + 1 : it, cur->Keys.end(), i});
+                break;
+            }
+            if (label.back() == '\0') { // key itself
+                S.push_back({upper ? it + 1 : it, cur->Keys.end(), i});
+                break;
+            }
+            S.push_back({it + 1, cur->Keys.end(), i});
+            i += label.size();
+            cur = it->Link;
+        }
+        K.assign(key.substr(0, i)); // the path is a prefix of key
+        Next();
+    }
+
+    template<typename TAllocator>
+    void TBasicCursor<TAllocator>::Next() noexcept {
+        while(!S.empty()) {
+            TFrame& top = S.back();
+            if (top.Next == top.End) {
+                S.pop_back();
+                continue;
+            }
+            auto it = top.Next++;
+            K.resize(top.KeySize);
+            const std::string_view label = T->Label(*it);
+            K.append(label); // the capacity is reused, it stops growing at the longest key
+            if (label.back() == '\0') {
+                K.pop_back(); // '\0'
+                Valid = !Limited || K < Hi;
+                if (!Valid)
+                    S.clear();
+                return;
+            }
+            S.push_back({it->Link->Keys.begin(), it->Link->Keys.end(), K.size()});
+        }
+        Valid = false;
+    }
+
+    template struct TBasicNode<std::allocator<char>>;
+    template struct TBasicNode<std::pmr::polymorphic_allocator<char>>;
+    template class TBasicTree<std::allocator<char>>;
+    template class TBasicIterator<std::allocator<char>>;
+    template class TBasicCursor<std::allocator<char>>;
+    template class TBasicTree<std::pmr::polymorphic_allocator<char>>;
+    template class TBasicIterator<std::pmr::polymorphic_allocator<char>>;
+    template class TBasicCursor<std::pmr::polymorphic_allocator<char>>;
 }
\ No newline at end of file
@@ -3,10 +3,13 @@
 /*
  *  R-way compressed trie / prefix tree
  *  1. Insert is quite slow, insert in the middle of a vector takes place: O(n)
- *  2. Search is quite fast
+ *  2. Search is quite fast: a node keeps the first bytes of its keys packed next to them,
+ *     the child is found with one SIMD compare per 16/32 children (SSE2/AVX2)
  *  3. Memory sufficient approach:
- *   - on big inputs std::string uses so called 'small string optimization'
- *   - R-way sorted vector of partial keys in each node
+ *   - an edge is 16 bytes: labels up to 4 bytes are inlined, longer ones are (offset, size)
+ *     in the byte pool of the tree, Split shares the bytes, removed labels are garbage until
+ *     the pool is compacted (when garbage is more than a half)
+ *   - R-way sorted vector of partial keys in each node (in the unsigned byte order = std::string order)
  * P.S. Currently it supports only null-terminated strings (realization is based on that fact)
  * P.P.S. Due to a specific application of this prefix tree, the interface is customized (not STL-like)
  *   TTree tree;
@@ -15,38 +18,113 @@
  *   tree.Remove("abc");
  *   for(auto it=tree.AllKeys();it;++it)
  *       std::cout << it.Key() << '\n';
+ *   tree.LongestPrefixOf("abcd"); // "abc": the longest stored key which is a prefix
+ *   tree.FuzzySearch("abd", 1);   // {{"abc", 1}}: keys within the edit distance
+ * P.P.P.S. NPmr::TTree keeps nodes, vectors and keys in a std::pmr::memory_resource:
+ *   NMemory::TPoolResource<> arena;
+ *   NPrefix::NPmr::TTree tree(&arena);
  */
 
 #include "defines.h"
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 
 namespace NPrefix {
-    struct TNode {
+    /* TAllocator is an allocator of char: std::allocator<char> or std::pmr::polymorphic_allocator<char>,
+     * it's rebound for nodes and vectors of keys
+     */
+    template<typename TAllocator>
+    struct TBasicNode {
+        template<typename T>
+        using TRebind = typename std::allocator_traits<TAllocator>::template rebind_alloc<T>;
+
+        // the label is read via TBasicTree::Label()
         struct TInner {
-            std::string Key;
-            TNode* Link;
-            // for Append
-            TInner(std::string_view key)
-                : Key(key)
-                , Link(nullptr)
-            {}
-            // for Split
-            TInner(std::string&& key, TNode* link)
-                : Key(key)
-                , Link(link)
-            {}
+            static constexpr ui32 ShortSize = 4;
+
+            ui32 Size;
+            union {
+                char Short[ShortSize]; // Size <= ShortSize
+                ui32 Offset;           // in the byte pool of the tree
+            };
+            // a leaf (its label ends with '\0') has no child: it carries the value of TBasicMap,
+            // the union is copied as a whole (Split/Join move a leaf with its value)
+            union {
+                TBasicNode* Link;
+                ui64 Payload;
+            };
         };
-        std::vector<TInner> Keys;
+        static_assert(sizeof(TInner) == 16);
+        using TKeys = std::vector<TInner, TRebind<TInner>>;
+        using TFirst = std::vector<ui8, TRebind<ui8>>;
+#ifdef __AVX2__
+        static constexpr size_t Lane = 32;
+#else
+        static constexpr size_t Lane = 16;
+#endif
+        TKeys Keys;
+        TFirst First; // Keys[i].Key.front(), padded with zeros up to a multiple of Lane
+
+        TBasicNode(const TAllocator& a = TAllocator())
+            : Keys(a)
+            , First(a)
+        {}
+        // Keys must be changed only via these methods to keep First in sync
+        TInner& Emplace(size_t pos, const TInner& inner, const char first) {
+            First.reserve(Padded(Keys.size() + 1)); // nothing may throw after Keys are changed
+            auto it = Keys.insert(Keys.begin() + pos, inner);
+            First.insert(First.begin() + pos, ui8(first));
+            First.resize(Padded(Keys.size()));
+            return *it;
+        }
+        void Erase(size_t pos) noexcept {
+            Keys.erase(Keys.begin() + pos);
+            First.erase(First.begin() + pos);
+            First.resize(Padded(Keys.size()));
+        }
+        void Clear() noexcept {
+            Keys.clear();
+            First.clear();
+        }
+        /* the index of the key starting with 'c' or Keys.size(), a SIMD search over First
+         * (PREFIX_SCALAR_FIND keeps the scalar one for the paired benchmark, see benchmark/Makefile)
+         */
+        size_t Find(char c) const noexcept;
+        /* the index of the first key which doesn't start with a byte less than 'c' */
+        size_t LowerBound(char c) const noexcept;
+    private:
+        static size_t Padded(const size_t size) noexcept {
+            return (size + Lane - 1) & ~(Lane - 1);
+        }
     };
     using TKeyRefs = std::vector<std::string_view>;
-    using TKeyIt = std::vector<TNode::TInner>::iterator;
-    using TCKeyIt = std::vector<TNode::TInner>::const_iterator;
 
-    class TTree;
-    class TIterator {
+    /* sorts in std::string order with a multikey quicksort in 'threads' threads */
+    void ParallelSort(TKeyRefs& keys, ui32 threads);
+    /* throws std::length_error if ui32 offsets can't address a byte pool of labels of this size */
+    void CheckLabelBytes(size_t size);
+
+    template<typename TAllocator>
+    class TBasicTree;
+    class TFrozenTree;
+    template<typename TValue, typename TAllocator>
+    class TBasicMap;
+
+    template<typename TAllocator>
+    class TBasicIterator {
     private:
+        using TNode = TBasicNode<TAllocator>;
+        using TCKeyIt = typename TNode::TKeys::const_iterator;
+        using TTree = TBasicTree<TAllocator>;
+
         struct TUnit {
             std::string P;
             TCKeyIt Begin;
@@ -77,33 +155,185 @@ namespace NPrefix {
     private:
         void GoDownToLeaf(std::string p, TCKeyIt b);
     public:
-        TIterator() : T(nullptr) {}
-        TIterator(const TTree* tree);
-        TIterator(std::string_view x, const TTree* tree);
+        TBasicIterator() : T(nullptr) {}
+        TBasicIterator(const TTree* tree);
+        TBasicIterator(std::string_view x, const TTree* tree);
         std::string Key() const noexcept { return S.back().P; }
         operator bool() const noexcept { return !S.empty(); }
-        TIterator& operator ++() noexcept;
-        TIterator& operator=(TIterator&& other) {
+        TBasicIterator& operator ++() noexcept;
+        TBasicIterator& operator=(TBasicIterator&& other) {
             S = std::move(other.S);
             T = other.T;
             return *this;
         }
     };
 
-    class TTree {
+    /* TBasicIterator without allocations per step: one key buffer is truncated to the length
+     * of the parent prefix and extended by the label on each descent, Key() is a view of it
+     * (valid until the next ++), the buffer and the stack are reused by Seek*()
+     *   TTree::TCursor cursor(tree);
+     *   for(cursor.Seek("pre"); cursor; ++cursor)
+     *       std::cout << cursor.Key() << '\n';
+     * Ordered scans seek in O(key length), the stack is left as if the smaller keys were visited:
+     *   for(cursor.SeekRange("apple", "banana"); cursor; ++cursor) // [apple, banana)
+     */
+    template<typename TAllocator>
+    class TBasicCursor {
     private:
+        using TNode = TBasicNode<TAllocator>;
+        using TCKeyIt = typename TNode::TKeys::const_iterator;
+        using TTree = TBasicTree<TAllocator>;
+
+        struct TFrame {
+            TCKeyIt Next;
+            TCKeyIt End;
+            size_t KeySize; // the prefix of the edges [Next, End)
+        };
+        std::vector<TFrame> S;
+        std::string K;
+        std::string Hi; // the end of a range
+        const TTree* T;
+        bool Valid = false;
+        bool Limited = false;
+    private:
+        void Next() noexcept;
+        void SeekBound(std::string_view key, bool upper);
+    public:
+        TBasicCursor(const TTree& tree)
+            : T(&tree)
+        {}
+        /* positions at the first key with the prefix, all keys for an empty one */
+        void Seek(std::string_view prefix);
+        /* positions at the first key >= key */
+        void SeekLowerBound(std::string_view key) {
+            Limited = false;
+            SeekBound(key, false);
+        }
+        /* positions at the first key > key */
+        void SeekUpperBound(std::string_view key) {
+            Limited = false;
+            SeekBound(key, true);
+        }
+        /* keys in [lo, hi) */
+        void SeekRange(std::string_view lo, std::string_view hi) {
+            Hi.assign(hi);
+            Limited = true;
+            SeekBound(lo, false);
+        }
+        std::string_view Key() const noexcept { return K; }
+        /* the value of the key in TBasicMap */
+        ui64 Payload() const noexcept { return std::prev(S.back().Next)->Payload; }
+        operator bool() const noexcept { return Valid; }
+        TBasicCursor& operator ++() noexcept {
+            Next();
+            return *this;
+        }
+    };
+
+    template<typename TAllocator>
+    class TBasicTree {
+    private:
+        using TNode = TBasicNode<TAllocator>;
+        using TInner = typename TNode::TInner;
+        using TKeyIt = typename TNode::TKeys::iterator;
+        using TNodeAllocator = typename TNode::template TRebind<TNode>;
+        using TIterator = TBasicIterator<TAllocator>;
+    public:
+        using TCursor = TBasicCursor<TAllocator>;
+    private:
+        using TBytes = std::vector<char, TAllocator>;
+
+        [[no_unique_address]] TAllocator A;
         TNode Root;
+        TBytes Bytes; // labels longer than TInner::ShortSize
+        size_t Garbage = 0; // bytes of removed labels in Bytes
         ui32 Size = 0;
     private:
         size_t Prefix(const std::string_view x, const std::string_view key) const noexcept;
-        TNode* Split(TNode::TInner& parent, ui32 i);
+        std::string_view Label(const TInner& inner) const noexcept {
+            if (inner.Size <= TInner::ShortSize)
+                return std::string_view(inner.Short, inner.Size);
+            return std::string_view(Bytes.data() + inner.Offset, inner.Size);
+        }
+        bool IsLeaf(const TInner& inner) const noexcept {
+            return Label(inner).back() == '\0';
+        }
+        /* the child node or nullptr for a leaf */
+        TNode* Child(const TInner& inner) const noexcept {
+            return IsLeaf(inner) ? nullptr : inner.Link;
+        }
+        TInner NewInner(std::string_view label, TNode* link = nullptr);
+        /* [from, from+size) of the label with the link (or the payload) of inner */
+        TInner SubInner(const TInner& inner, size_t from, size_t size) const noexcept;
+        void Forget(const TInner& inner) noexcept;
+        void Compact();
+        TNode* NewNode();
+        void DeleteNode(TNode* node) noexcept;
+        TNode* Split(TInner& parent, ui32 i);
+        // the rightmost path of the tree being built: nodes with the length of their prefix
+        struct TBuildState {
+            std::vector<std::pair<TNode*, size_t>> Path;
+            std::string Prev;
+            std::string Cur;
+        };
+        void BuildNext(TBuildState& state, std::string_view key);
+        void BuildParallelRefs(TKeyRefs& keys, ui32 threads);
+        // nodes from the top with the index of the next edge
+        using TPath = std::vector<std::pair<TNode*, size_t>>;
+        /* adds base to the offsets of long labels of the edge and its subtree,
+         * 'path' has room for the depth of the subtree (no allocations)
+         */
+        void ShiftOffsets(TInner& edge, size_t base, TPath& path) noexcept;
         void Join(TNode* cur, TKeyIt parent);
-        bool AppendStrView(std::string_view x);
-        bool ExistsStrView(std::string_view x) const noexcept;
+        /* the leaf of x (with '\0') and whether it's new, the pointer is valid until the next change */
+        std::pair<TInner*, bool> AppendLeaf(std::string_view x);
+        bool AppendStrView(std::string_view x) {
+            return AppendLeaf(x).second;
+        }
+        const TInner* FindLeaf(std::string_view x) const noexcept;
+        bool ExistsStrView(std::string_view x) const noexcept {
+            return FindLeaf(x) != nullptr;
+        }
         bool RemoveStrView(std::string_view x);
+        /* f(size_t size, const TInner& leaf) for keys which are prefixes of x (without '\0')
+         * from the shortest one, stops when f returns false: one descent along x
+         */
+        template<typename TFunc>
+        void PrefixLeaves(std::string_view x, TFunc&& f) const noexcept {
+            const TNode* cur = &Root;
+            for(size_t i=0;;) {
+                const auto& keys = cur->Keys;
+                if (keys.empty())
+                    return;
+                if (cur->First.front() == '\0' && !f(i, keys.front())) // x[0, i) is a key
+                    return;
+                if (i == x.size())
+                    return;
+                const size_t pos = cur->Find(x[i]);
+                if (pos == keys.size())
+                    return;
+                const std::string_view label = Label(keys[pos]);
+                const size_t rest = x.size() - i;
+                if (label.back() == '\0') { // a leaf: its key is a prefix of x or nothing below is
+                    if (label.size() - 1 <= rest && x.compare(i, label.size() - 1, label.substr(0, label.size() - 1)) == 0)
+                        f(i + label.size() - 1, keys[pos]);
+                    return;
+                }
+                if (label.size() > rest || x.compare(i, label.size(), label) != 0)
+                    return;
+                i += label.size();
+                cur = keys[pos].Link;
+            }
+        }
     public:
-        TTree(){}
-        ~TTree() {
+        TBasicTree(const TAllocator& a = TAllocator())
+            : A(a)
+            , Root(a)
+            , Bytes(a)
+        {}
+        TBasicTree(const TBasicTree&) = delete;
+        TBasicTree& operator=(const TBasicTree&) = delete;
+        ~TBasicTree() {
             clear();
         }
         bool Append(const std::string& s) {
@@ -114,6 +344,10 @@ namespace NPrefix {
             // copy '\0' too, it's very important
             return ExistsStrView(std::string_view(x.c_str(), x.size()+1));
         }
+        /* found[i] = Exists(keys[i]), the lookups are interleaved to overlap their cache misses,
+         * found.size() must be >= keys.size()
+         */
+        void ExistsBatch(std::span<const std::string_view> keys, std::span<bool> found) const noexcept;
         bool Remove(const std::string& s) {
             return RemoveStrView(std::string_view(s.c_str(), s.size()+1));
         }
@@ -123,6 +357,60 @@ namespace NPrefix {
         TIterator AllKeys() const noexcept {
             return TIterator(this);
         }
+        TCursor CursorWithPrefix(std::string_view prefix) const {
+            TCursor cursor(*this);
+            cursor.Seek(prefix);
+            return cursor;
+        }
+        TCursor LowerBound(std::string_view key) const {
+            TCursor cursor(*this);
+            cursor.SeekLowerBound(key);
+            return cursor;
+        }
+        TCursor UpperBound(std::string_view key) const {
+            TCursor cursor(*this);
+            cursor.SeekUpperBound(key);
+            return cursor;
+        }
+        /* keys in [lo, hi) in order */
+        TCursor Range(std::string_view lo, std::string_view hi) const {
+            TCursor cursor(*this);
+            cursor.SeekRange(lo, hi);
+            return cursor;
+        }
+        /* f(std::string_view) for keys with the prefix in order, stops when f returns false */
+        template<typename TFunc>
+        void ForEachWithPrefix(std::string_view prefix, TFunc&& f) const {
+            for(TCursor cursor = CursorWithPrefix(prefix); cursor; ++cursor)
+                if constexpr (std::is_same_v<std::invoke_result_t<TFunc&, std::string_view>, bool>) {
+                    if (!f(cursor.Key()))
+                        return;
+                } else {
+                    f(cursor.Key());
+                }
+        }
+        /* the longest key which is a prefix of x (x itself included) as a view of x: O(|x|) */
+        std::optional<std::string_view> LongestPrefixOf(std::string_view x) const noexcept {
+            std::optional<std::string_view> longest;
+            PrefixLeaves(x, [&](size_t size, const TInner&) {
+                longest = x.substr(0, size);
+                return true;
+            });
+            return longest;
+        }
+        /* keys within Levenshtein distance maxDistance of the query with their distances in order,
+         * subtrees which can't match any more are skipped
+         */
+        std::vector<std::pair<std::string, ui32>> FuzzySearch(std::string_view query, ui32 maxDistance) const;
+        /* keys which are prefixes of x from the shortest one as views of x: O(|x|) */
+        std::vector<std::string_view> AllPrefixesOf(std::string_view x) const {
+            std::vector<std::string_view> all;
+            PrefixLeaves(x, [&](size_t size, const TInner&) {
+                all.push_back(x.substr(0, size));
+                return true;
+            });
+            return all;
+        }
 
         template<size_t N>
         bool Append(const char(&s)[N]) {
@@ -134,6 +422,41 @@ namespace NPrefix {
             return AppendStrView(std::string_view(x.c_str(), x.size()+1));
         }
 
+        /* replaces the content with 'keys' sorted in std::string order (duplicates are skipped)
+         * in one pass: O(total length), throws std::invalid_argument on unsorted input
+         */
+        template<typename TRange>
+        void BuildFromSorted(const TRange& keys) {
+            clear();
+            TBuildState state;
+            state.Path.emplace_back(&Root, 0);
+            for(const auto& key: keys)
+                BuildNext(state, std::string_view(key));
+        }
+        /* BuildFromSorted() for any order, the keys are sorted in parallel first */
+        template<typename TRange>
+        void BuildFromUnsorted(const TRange& keys, const ui32 threads = std::thread::hardware_concurrency()) {
+            TKeyRefs refs;
+            for(const auto& key: keys)
+                refs.emplace_back(key);
+            ParallelSort(refs, threads);
+            BuildFromSorted(refs);
+        }
+
+        /* BuildFromUnsorted() with the subtrees of the root built in parallel: the keys are split
+         * by the first byte, each part is sorted and built by one of 'threads' threads on its own
+         * and attached under the root afterwards
+         * P.S. the threads allocate nodes from the allocator of the tree: a memory resource of
+         * NPmr::TTree must be thread-safe (std::pmr::synchronized_pool_resource) unless threads == 1
+         */
+        template<typename TRange>
+        void BuildParallel(const TRange& keys, const ui32 threads = std::thread::hardware_concurrency()) {
+            TKeyRefs refs;
+            for(const auto& key: keys)
+                refs.emplace_back(key);
+            BuildParallelRefs(refs, threads);
+        }
+
         template<size_t N>
         bool Exists(const char(&x)[N]) {
             if (x[N-1] == '\0')
@@ -147,7 +470,25 @@ namespace NPrefix {
         TKeyRefs InOrder() const noexcept;
         void clear() noexcept;
         ui32 size() const noexcept { return Size; }
+        /* the size of the byte pool of labels, garbage included */
+        size_t LabelBytes() const noexcept { return Bytes.size(); }
 
-        friend class TIterator;
+        friend class TBasicIterator<TAllocator>;
+        friend class TBasicCursor<TAllocator>;
+        friend class TFrozenTree;
+        template<typename TValue, typename TMapAllocator>
+        friend class TBasicMap;
     };
+
+    using TNode = TBasicNode<std::allocator<char>>;
+    using TTree = TBasicTree<std::allocator<char>>;
+    using TIterator = TBasicIterator<std::allocator<char>>;
+    using TCursor = TBasicCursor<std::allocator<char>>;
+
+    namespace NPmr {
+        using TNode = TBasicNode<std::pmr::polymorphic_allocator<char>>;
+        using TTree = TBasicTree<std::pmr::polymorphic_allocator<char>>;
+        using TIterator = TBasicIterator<std::pmr::polymorphic_allocator<char>>;
+        using TCursor = TBasicCursor<std::pmr::polymorphic_allocator<char>>;
+    }
 }
\ No newline at end of file
@@ -226,9 +226,10 @@ namespace NRBTree {
             }
         };
         auto rbDeleteFixup = [this](TNode* p, TNode*& pLeaf, TNode* x, bool yoc) {
-            // p == Nil if deleted node was Root
-            if (p == Nil || yoc == RED) return;
+            if (yoc == RED) return;
             if (x != Nil) return RbDeleteFixup(x);
+            // p == Nil if deleted node was Root
+            if (p == Nil) return;
             // thread safe emulation
             TNode dummyX = TNode(TNode::TForNilObj()); pLeaf = &dummyX; dummyX.Parent = p;
             RbDeleteFixup(&dummyX);
@@ -246,8 +247,10 @@ namespace NRBTree {
 
         if (z->Left == Nil) {
             x = z->Right;
-            Transplant(z, z->Right); FixSize(z->Parent);
-            return rbDeleteFixup(z->Parent, z->Parent->Right, x, y_original_color), z;
+            TNode* p = z->Parent;
+            bool zIsLeftChild = z == p->Left;
+            Transplant(z, z->Right); FixSize(p);
+            return rbDeleteFixup(p, zIsLeftChild ? p->Left : p->Right, x, y_original_color), z;
         }
         if (z->Right == Nil) {
             x = z->Left;
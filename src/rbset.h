@@ -14,6 +14,9 @@
 #include <vector>
 
 namespace NRBTree {
+    /* TAllocator contract: static Allocate(size) and static DeAllocate(ptr) or DeAllocate(ptr, size),
+     * the sized one is preferred when both are present
+     */
     struct TDefaultAllocator {
         static void* Allocate(size_t size) {
             return ::operator new(size);
@@ -32,7 +35,10 @@ namespace NRBTree {
         }
         static void Destruct(T* obj) noexcept {
             obj->~T();
-            TAllocator::DeAllocate(obj);
+            if constexpr (requires { TAllocator::DeAllocate(obj, sizeof(T)); })
+                TAllocator::DeAllocate(obj, sizeof(T));
+            else
+                TAllocator::DeAllocate(obj);
         }
     };
 
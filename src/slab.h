@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+ * Size-class (slab) allocator on top of NMemory::TPool
+ *  1. Requests are rounded up to 16 bytes, each size class keeps an intrusive free list
+ *  2. Allocate/DeAllocate are O(1): pop/push a free list or bump the pool
+ *  3. Memory goes back to the system only with the slab itself (TPool frees everything at once)
+ *  4. Requests bigger than MaxSize are served by ::operator new
+ *
+ * TSlabAllocator is a thread-local slab satisfying NRBTree TAllocator contract:
+ *   NRBTree::TSet<ui32, NMemory::TSlabAllocator<>> set;
+ * P.S. a container must be destroyed by the thread which has filled it and before the thread exits
+ */
+
+#include "mempool.h"
+#include <iterator>
+#include <new>
+
+
+namespace NMemory {
+    template<typename TPoolType = TPool<TExponentialStrategy>, size_t MaxSize = 256>
+    class TSlab {
+    private:
+        static constexpr size_t Granularity = 16;
+        static constexpr size_t ClassesCount = MaxSize / Granularity;
+        static_assert(MaxSize % Granularity == 0, "MaxSize must be a multiple of 16");
+
+        struct TFree {
+            TFree* Next;
+        };
+        TPoolType Pool;
+        TFree* Free[ClassesCount] = {};
+        TStats S; // requests to the slab, the pool sees only the chunks carved from it
+    private:
+        static size_t Class(const size_t size) noexcept {
+            return (size + (size == 0) - 1) / Granularity;
+        }
+    public:
+        TSlab() {}
+        TSlab(const size_t blockSize)
+            : Pool(blockSize)
+        {}
+        TSlab(const TSlab&) = delete;
+        TSlab& operator=(const TSlab&) = delete;
+
+        void* Allocate(const size_t size) {
+            S.Count(size);
+            if (size > MaxSize)
+                return ::operator new(size);
+            size_t c = Class(size);
+            if (TFree* f = Free[c]) {
+                Free[c] = f->Next;
+                return f;
+            }
+            return Pool.Allocate((c + 1) * Granularity, Granularity);
+        }
+        void DeAllocate(void* ptr, const size_t size) noexcept {
+            if (size > MaxSize)
+                return ::operator delete(ptr);
+            size_t c = Class(size);
+            Free[c] = new (ptr) TFree{Free[c]};
+        }
+        TStats Stats() const noexcept {
+            TStats s = Pool.Stats();
+            s.Requested = S.Requested;
+            s.Allocations = S.Allocations;
+            std::copy(std::begin(S.Buckets), std::end(S.Buckets), std::begin(s.Buckets));
+            return s;
+        }
+        size_t BlocksCount() const noexcept { return Pool.BlocksCount(); }
+    };
+
+    template<typename TSlabType = TSlab<>>
+    struct TSlabAllocator {
+        static TSlabType& Local() {
+            static thread_local TSlabType slab;
+            return slab;
+        }
+        static void* Allocate(size_t size) {
+            return Local().Allocate(size);
+        }
+        static void DeAllocate(void* ptr, size_t size) noexcept {
+            Local().DeAllocate(ptr, size);
+        }
+        static TStats Stats() {
+            return Local().Stats();
+        }
+    };
+}
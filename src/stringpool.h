@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+ * String interning on top of NMemory::TPool
+ *  1. Each distinct string is stored once in the pool, its id is the order of the first Intern()
+ *  2. The index is an open addressing table (linear probing, load factor <= 1/2)
+ *     of {hash, id} pairs: 8 bytes per slot, the bytes are compared on a hash match only
+ *  3. Ids and views are stable while the pool lives: the pool never moves strings
+ *
+ *   NMemory::TStringPool<> strings;
+ *   ui32 id = strings.Intern(word); // the same id for the same word
+ *   std::string_view w = strings.View(id);
+ */
+
+#include "mempool.h"
+#include <functional>
+#include <string_view>
+#include <vector>
+
+
+namespace NMemory {
+    template<typename TPoolType = TPool<TExponentialStrategy>>
+    class TStringPool {
+    private:
+        static constexpr size_t DefaultBlockSize = 1 << 16;
+        static constexpr size_t MinSlots = 16;
+        static constexpr ui32 Empty = ui32(-1);
+
+        struct TSlot {
+            ui32 Hash;
+            ui32 Id = Empty;
+        };
+        TPoolType P;
+        std::vector<std::string_view> Views;
+        std::vector<TSlot> Slots;
+    public:
+        static constexpr ui32 NotFound = Empty;
+    private:
+        static ui32 Hash(const std::string_view s) noexcept {
+            return static_cast<ui32>(std::hash<std::string_view>()(s));
+        }
+        size_t Mask() const noexcept { return Slots.size() - 1; }
+        // the slot with the string or the empty one where it should be
+        size_t Find(const std::string_view s, const ui32 h) const noexcept {
+            size_t i = h & Mask();
+            while(Slots[i].Id != Empty && (Slots[i].Hash != h || Views[Slots[i].Id] != s))
+                i = (i + 1) & Mask();
+            return i;
+        }
+        void Rehash() {
+            std::vector<TSlot> slots(Slots.size() * 2);
+            Slots.swap(slots);
+            for(const TSlot& slot: slots) {
+                if (slot.Id == Empty)
+                    continue;
+                size_t i = slot.Hash & Mask();
+                while(Slots[i].Id != Empty)
+                    i = (i + 1) & Mask();
+                Slots[i] = slot;
+            }
+        }
+    public:
+        TStringPool(const size_t blockSize = DefaultBlockSize)
+            : P(blockSize)
+            , Slots(MinSlots)
+        {}
+        TStringPool(const TStringPool&) = delete;
+        TStringPool& operator=(const TStringPool&) = delete;
+
+        /* the id of 's', the string is copied into the pool on the first occurrence */
+        ui32 Intern(const std::string_view s) {
+            const ui32 h = Hash(s);
+            size_t i = Find(s, h);
+            if (Slots[i].Id != Empty)
+                return Slots[i].Id;
+            if ((Views.size() + 1) * 2 > Slots.size()) {
+                Rehash();
+                i = Find(s, h);
+            }
+            TUtil::ReserveOneMore(Views); // nothing may throw after the copy
+            const char* ptr = s.empty() ? nullptr : P.Append(s.data(), s.size());
+            const ui32 id = static_cast<ui32>(Views.size());
+            Views.emplace_back(ptr, s.size());
+            Slots[i] = {h, id};
+            return id;
+        }
+        /* the id of 's' or NotFound, nothing is inserted */
+        ui32 Id(const std::string_view s) const noexcept {
+            return Slots[Find(s, Hash(s))].Id;
+        }
+        bool Exists(const std::string_view s) const noexcept {
+            return Id(s) != NotFound;
+        }
+        std::string_view View(const ui32 id) const noexcept {
+            return Views[id];
+        }
+
+        size_t size() const noexcept { return Views.size(); }
+        TStats Stats() const noexcept {
+            TStats s = P.Stats();
+            s.Reserved += Views.capacity() * sizeof(std::string_view) + Slots.capacity() * sizeof(TSlot);
+            return s;
+        }
+    };
+}
@@ -13,6 +13,7 @@
 
 #include "defines.h"
 #include <iostream>
+#include <limits>
 
 
 namespace NvanEmdeBoas{
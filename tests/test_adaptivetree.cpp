@@ -0,0 +1,123 @@
+#include "adaptivetree.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+using namespace NPrefix;
+
+
+static std::vector<std::string> Keys(TAdaptiveTree::TIterator it) {
+    std::vector<std::string> keys;
+    for(; it; ++it)
+        keys.push_back(it.Key());
+    return keys;
+}
+
+TEST(TAdaptiveTree, Basic) {
+    TAdaptiveTree tree;
+    EXPECT_TRUE(tree.Append("she"));
+    EXPECT_TRUE(tree.Append("sells"));
+    EXPECT_TRUE(tree.Append("sea"));
+    EXPECT_TRUE(tree.Append("shells"));
+    EXPECT_TRUE(tree.Append("by"));
+    EXPECT_TRUE(tree.Append("the"));
+    EXPECT_FALSE(tree.Append("sea"));
+    EXPECT_TRUE(tree.Append("shore"));
+    EXPECT_TRUE(tree.Append("s"));
+    EXPECT_EQ(tree.size(), 8U);
+
+    EXPECT_TRUE(tree.Exists("s"));
+    EXPECT_TRUE(tree.Exists("shells"));
+    EXPECT_FALSE(tree.Exists("sh"));
+    EXPECT_FALSE(tree.Exists("shellsx"));
+    EXPECT_FALSE(tree.Exists(""));
+
+    using V = std::vector<std::string>;
+    EXPECT_EQ(Keys(tree.AllKeys()), V({"by", "s", "sea", "sells", "she", "shells", "shore", "the"}));
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("sh")), V({"she", "shells", "shore"}));
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("she")), V({"she", "shells"}));
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("t")), V({"the"}));
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("x")), V());
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("thex")), V());
+
+    EXPECT_TRUE(tree.Remove("she"));
+    EXPECT_FALSE(tree.Remove("she"));
+    EXPECT_FALSE(tree.Remove("sh"));
+    EXPECT_TRUE(tree.Exists("shells"));
+    EXPECT_EQ(tree.size(), 7U);
+}
+
+TEST(TAdaptiveTree, LongPrefixes) {
+    TAdaptiveTree tree;
+    const std::string p(20, 'a');
+    tree.Append(p + "x");
+    tree.Append(p + "y");
+    EXPECT_TRUE(tree.Exists(p + "x"));
+    EXPECT_FALSE(tree.Exists(std::string(19, 'a') + "bx")); // differs in the not inlined part
+    EXPECT_FALSE(tree.Exists(p));
+
+    tree.Append(std::string(12, 'a') + "b"); // splits the prefix after the inlined part
+    tree.Append(std::string(3, 'a') + "c");  // and inside it
+    tree.Append(std::string(20, 'a'));       // a key ends inside a path
+    using V = std::vector<std::string>;
+    EXPECT_EQ(Keys(tree.KeysWithPrefix(std::string(13, 'a'))), V({p, p + "x", p + "y"}));
+    EXPECT_EQ(Keys(tree.KeysWithPrefix(std::string(12, 'a') + "b")), V({std::string(12, 'a') + "b"}));
+    EXPECT_EQ(Keys(tree.KeysWithPrefix(std::string(12, 'a') + "c")), V());
+
+    // removes collapse Node4 and merge the prefixes
+    EXPECT_TRUE(tree.Remove(std::string(3, 'a') + "c"));
+    EXPECT_TRUE(tree.Remove(std::string(12, 'a') + "b"));
+    EXPECT_TRUE(tree.Remove(p));
+    EXPECT_TRUE(tree.Exists(p + "y"));
+    EXPECT_FALSE(tree.Exists(std::string(19, 'a') + "by"));
+    EXPECT_EQ(Keys(tree.AllKeys()), V({p + "x", p + "y"}));
+}
+
+TEST(TAdaptiveTree, NodeKinds) {
+    TAdaptiveTree tree;
+    std::vector<std::string> keys;
+    for(ui32 b=1; b<256; ++b) // Node4 -> 16 -> 48 -> 256
+        keys.push_back(std::string("k") + char(b));
+    for(const auto& k: keys)
+        EXPECT_TRUE(tree.Append(k));
+    for(const auto& k: keys)
+        EXPECT_TRUE(tree.Exists(k));
+    EXPECT_EQ(Keys(tree.AllKeys()), keys);
+
+    for(ui32 i=0; i+1<keys.size(); ++i) { // 256 -> 48 -> 16 -> 4 -> leaf
+        EXPECT_TRUE(tree.Remove(keys[i]));
+        EXPECT_FALSE(tree.Exists(keys[i]));
+        EXPECT_TRUE(tree.Exists(keys.back()));
+    }
+    EXPECT_EQ(tree.size(), 1U);
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("k")), std::vector<std::string>({keys.back()}));
+}
+
+TEST(TAdaptiveTree, Random) {
+    TAdaptiveTree tree;
+    std::set<std::string> set;
+    std::mt19937 rng(42);
+    auto word = [&rng]() {
+        std::string w(rng() % 12 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 4;
+        return rng() % 2 ? std::string(10, 'a') + w : w; // long compressed paths
+    };
+    for(ui32 i=0; i<20000; ++i) {
+        std::string w = word();
+        if (rng() % 3 == 0)
+            EXPECT_EQ(tree.Remove(w), set.erase(w) == 1);
+        else
+            EXPECT_EQ(tree.Append(w), set.insert(w).second);
+    }
+    EXPECT_EQ(tree.size(), set.size());
+    EXPECT_EQ(Keys(tree.AllKeys()), std::vector<std::string>(set.begin(), set.end()));
+    std::vector<std::string> expected;
+    for(const auto& w: set)
+        if (w.starts_with("abc"))
+            expected.push_back(w);
+    EXPECT_EQ(Keys(tree.KeysWithPrefix("abc")), expected);
+    tree.clear();
+    EXPECT_EQ(tree.size(), 0U);
+    EXPECT_FALSE(tree.AllKeys());
+}
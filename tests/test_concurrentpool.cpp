@@ -0,0 +1,96 @@
+#include "concurrentpool.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace NMemory;
+
+
+TEST(TConcurrentPool, Shard) {
+    TConcurrentPool<> pool(256);
+    TConcurrentPool<>::TShard shard(pool);
+    EXPECT_EQ(pool.BlocksCount(), 0ULL); // lazy
+
+    char* c = static_cast<char*>(shard.Allocate(1, 1));
+    ui64* x = shard.Emplace<ui64>(42);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(x) % alignof(ui64), 0ULL);
+    EXPECT_EQ(*x, 42ULL);
+    EXPECT_LT(c, reinterpret_cast<char*>(x));
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+
+    for(ui32 i=0; i<100; ++i)
+        shard.Emplace<ui64>(i);
+    EXPECT_GT(pool.BlocksCount(), 1ULL);
+    EXPECT_THROW(shard.Allocate(256), std::runtime_error);
+    EXPECT_THROW(shard.Allocate(std::numeric_limits<size_t>::max() - 8, 16), std::runtime_error);
+    EXPECT_THROW(shard.Allocate(16, size_t(1) << 63), std::runtime_error);
+}
+
+TEST(TConcurrentPool, SmallBlock) {
+    EXPECT_THROW(TConcurrentPool<>(1), std::invalid_argument);
+    EXPECT_THROW(TConcurrentPool<>(16), std::invalid_argument);
+    TConcurrentPool<> pool(64);
+    TConcurrentPool<>::TShard shard(pool);
+    EXPECT_NE(shard.Allocate(1, 1), nullptr);
+}
+
+TEST(TConcurrentPool, Threads) {
+    constexpr ui32 Threads = 4;
+    constexpr ui32 PerThread = 10000;
+    TConcurrentPool<> pool(1024);
+    pool.Reserve(8);
+    std::vector<std::vector<ui64*>> result(Threads);
+    std::vector<std::thread> threads;
+    for(ui32 t=0; t<Threads; ++t)
+        threads.emplace_back([&pool, &result, t] {
+            TConcurrentPool<>::TShard shard(pool);
+            for(ui32 i=0; i<PerThread; ++i)
+                result[t].push_back(shard.Emplace<ui64>(ui64(t) * PerThread + i));
+        });
+    for(auto& th: threads)
+        th.join();
+
+    std::vector<ui64*> all;
+    for(ui32 t=0; t<Threads; ++t) {
+        for(ui32 i=0; i<PerThread; ++i)
+            EXPECT_EQ(*result[t][i], ui64(t) * PerThread + i);
+        all.insert(all.end(), result[t].begin(), result[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end()); // no overlapping
+
+    size_t blocks = pool.BlocksCount();
+    pool.Reset(); // the next build takes the same blocks
+    {
+        TConcurrentPool<>::TShard shard(pool);
+        for(ui32 i=0; i<PerThread; ++i)
+            shard.Emplace<ui64>(i);
+    }
+    EXPECT_EQ(pool.BlocksCount(), blocks);
+}
+
+TEST(TConcurrentPool, ReserveWhileAllocating) {
+    constexpr ui32 Threads = 3;
+    constexpr ui32 PerThread = 10000;
+    TConcurrentPool<> pool(512);
+    std::vector<std::vector<ui64*>> result(Threads);
+    std::vector<std::thread> threads;
+    for(ui32 t=0; t<Threads; ++t)
+        threads.emplace_back([&pool, &result, t] {
+            TConcurrentPool<>::TShard shard(pool);
+            for(ui32 i=0; i<PerThread; ++i)
+                result[t].push_back(shard.Emplace<ui64>(i));
+        });
+    for(ui32 i=0; i<64; ++i)
+        pool.Reserve(4);
+    for(auto& th: threads)
+        th.join();
+
+    std::vector<ui64*> all;
+    for(const auto& r: result)
+        all.insert(all.end(), r.begin(), r.end());
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+}
@@ -0,0 +1,95 @@
+#include "concurrenttree.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <set>
+#include <thread>
+
+using namespace NPrefix;
+
+
+static std::vector<std::string> Keys(const TConcurrentTree::TReader& reader, std::string_view prefix) {
+    std::vector<std::string> keys;
+    reader.ForEachWithPrefix(prefix, [&keys](std::string_view key) { keys.emplace_back(key); });
+    return keys;
+}
+
+TEST(TConcurrentTree, Basic) {
+    TConcurrentTree tree;
+    TConcurrentTree::TReader reader(tree);
+    EXPECT_FALSE(reader.Exists(""));
+    for(auto key: {"she", "sells", "sea", "shells", "by", "the", "shore", "s"})
+        EXPECT_TRUE(tree.Append(key));
+    EXPECT_FALSE(tree.Append("sea"));
+    EXPECT_EQ(tree.size(), 8U);
+
+    EXPECT_TRUE(reader.Exists("s"));
+    EXPECT_TRUE(reader.Exists("shells"));
+    EXPECT_FALSE(reader.Exists("sh"));
+    EXPECT_FALSE(reader.Exists("shellsx"));
+    using V = std::vector<std::string>;
+    EXPECT_EQ(Keys(reader, ""), V({"by", "s", "sea", "sells", "she", "shells", "shore", "the"}));
+    EXPECT_EQ(Keys(reader, "sh"), V({"she", "shells", "shore"}));
+    EXPECT_EQ(Keys(reader, "shel"), V({"shells"}));
+    EXPECT_EQ(Keys(reader, "x"), V());
+
+    EXPECT_TRUE(tree.Remove("she"));
+    EXPECT_FALSE(tree.Remove("she"));
+    EXPECT_FALSE(tree.Remove("sh"));
+    EXPECT_TRUE(tree.Remove("shore")); // "shells" is joined back to "s"
+    EXPECT_EQ(Keys(reader, "sh"), V({"shells"}));
+    EXPECT_EQ(tree.size(), 6U);
+}
+
+TEST(TConcurrentTree, Random) {
+    TConcurrentTree tree;
+    TConcurrentTree::TReader reader(tree);
+    std::set<std::string> set;
+    std::mt19937 rng(5);
+    for(ui32 i=0; i<20000; ++i) {
+        std::string w(rng() % 8 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 3 + (rng() % 16 == 0 ? 0x80 : 0);
+        if (rng() % 3 == 0)
+            EXPECT_EQ(tree.Remove(w), set.erase(w) == 1);
+        else
+            EXPECT_EQ(tree.Append(w), set.insert(w).second);
+    }
+    EXPECT_EQ(tree.size(), set.size());
+    EXPECT_EQ(Keys(reader, ""), std::vector<std::string>(set.begin(), set.end()));
+    for(const auto& w: set)
+        EXPECT_TRUE(reader.Exists(w));
+    EXPECT_LT(tree.RetiredCount(), 128U); // no reader is in progress, nodes are reclaimed
+}
+
+TEST(TConcurrentTree, ReadersAndWriter) {
+    TConcurrentTree tree;
+    std::vector<std::string> stable, changing;
+    for(ui32 i=0; i<2000; ++i) {
+        stable.push_back("key" + std::to_string(i));
+        changing.push_back("key" + std::to_string(i) + "x");
+        tree.Append(stable.back());
+    }
+    std::atomic<bool> stop = false;
+    std::atomic<ui32> broken = 0;
+    std::vector<std::thread> readers;
+    for(ui32 t=0; t<3; ++t)
+        readers.emplace_back([&]() {
+            TConcurrentTree::TReader reader(tree);
+            while(!stop.load())
+                for(const auto& key: stable)
+                    if (!reader.Exists(key)) // splits and joins nearby must not hide them
+                        ++broken;
+        });
+    for(ui32 round=0; round<5; ++round) {
+        for(const auto& key: changing)
+            tree.Append(key);
+        for(const auto& key: changing)
+            tree.Remove(key);
+    }
+    stop = true;
+    for(auto& r: readers)
+        r.join();
+    EXPECT_EQ(broken.load(), 0U);
+    EXPECT_EQ(tree.size(), stable.size());
+}
@@ -0,0 +1,109 @@
+#include "frozentree.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+using namespace NPrefix;
+
+
+static std::vector<std::string> Keys(TFrozenTree::TIterator it) {
+    std::vector<std::string> keys;
+    for(; it; ++it)
+        keys.push_back(it.Key());
+    return keys;
+}
+template<typename TIt>
+static std::vector<std::string> TreeKeys(TIt it) {
+    std::vector<std::string> keys;
+    for(; it; ++it)
+        keys.push_back(it.Key());
+    return keys;
+}
+
+TEST(TFrozenTree, Basic) {
+    TTree tree;
+    for(auto key: {"she", "sells", "sea", "shells", "by", "the", "sea", "shore", "s", "a very long word to be a tail"})
+        tree.Append(std::string(key));
+    const TFrozenTree frozen = TFrozenTree::Freeze(tree);
+    EXPECT_EQ(frozen.size(), 9U);
+
+    for(auto key: {"she", "sells", "sea", "shells", "by", "the", "shore", "s", "a very long word to be a tail"})
+        EXPECT_TRUE(frozen.Exists(key));
+    for(auto key: {"", "sh", "shel", "shellsx", "b", "a very long word", "x", "the "})
+        EXPECT_FALSE(frozen.Exists(key));
+
+    using V = std::vector<std::string>;
+    EXPECT_EQ(Keys(frozen.AllKeys()), TreeKeys(tree.AllKeys()));
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("sh")), V({"she", "shells", "shore"}));
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("shel")), V({"shells"}));
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("s")), V({"s", "sea", "sells", "she", "shells", "shore"}));
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("a very")), V({"a very long word to be a tail"}));
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("shellsx")), V());
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("z")), V());
+
+    TTree empty;
+    const TFrozenTree none = TFrozenTree::Freeze(empty);
+    EXPECT_EQ(none.size(), 0U);
+    EXPECT_FALSE(none.Exists(""));
+    EXPECT_FALSE(none.AllKeys());
+    EXPECT_FALSE(TFrozenTree().Exists("a"));
+}
+
+TEST(TFrozenTree, SaveOpen) {
+    std::mt19937 rng(11);
+    TTree tree;
+    std::vector<std::string> words;
+    for(ui32 i=0; i<50000; ++i) { // many blocks of the bitvectors
+        std::string w(rng() % 12 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 5 + (rng() % 32 == 0 ? 0x80 : 0);
+        words.push_back(w);
+        tree.Append(w);
+    }
+    const std::string path = testing::TempDir() + "frozentree.louds";
+    TFrozenTree::Freeze(tree).Save(path);
+    {
+        TFrozenTree frozen = TFrozenTree::Open(path);
+        EXPECT_EQ(frozen.size(), tree.size());
+        for(const auto& w: words)
+            EXPECT_TRUE(frozen.Exists(w));
+        for(const auto& w: words)
+            EXPECT_EQ(frozen.Exists(w + "a"), tree.Exists(w + "a"));
+        EXPECT_EQ(Keys(frozen.AllKeys()), TreeKeys(tree.AllKeys()));
+        EXPECT_EQ(Keys(frozen.KeysWithPrefix("abc")), TreeKeys(tree.KeysWithPrefix("abc")));
+
+        TFrozenTree moved = std::move(frozen);
+        EXPECT_TRUE(moved.Exists(words[0]));
+        EXPECT_EQ(frozen.size(), 0U);
+    }
+    {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a tree";
+        EXPECT_THROW(TFrozenTree::Open(path), std::runtime_error);
+    }
+    std::remove(path.c_str());
+    EXPECT_THROW(TFrozenTree::Open(path), std::runtime_error);
+}
+
+TEST(TFrozenTree, EmptySaveOpen) {
+    const std::string path = testing::TempDir() + "frozentree_empty.louds";
+    TTree empty;
+    TFrozenTree::Freeze(empty).Save(path);
+    {
+        const TFrozenTree frozen = TFrozenTree::Open(path);
+        EXPECT_EQ(frozen.size(), 0U);
+        EXPECT_FALSE(frozen.Exists(""));
+        EXPECT_FALSE(frozen.Exists("a"));
+        EXPECT_FALSE(frozen.AllKeys());
+        EXPECT_FALSE(frozen.KeysWithPrefix("a"));
+    }
+    TTree bytes; // one byte keys, nothing long
+    bytes.Append("a");
+    bytes.Append("b");
+    const TFrozenTree frozen = TFrozenTree::Freeze(bytes);
+    EXPECT_TRUE(frozen.Exists("a"));
+    EXPECT_FALSE(frozen.Exists(""));
+    EXPECT_FALSE(frozen.Exists("ab"));
+    EXPECT_EQ(Keys(frozen.KeysWithPrefix("b")), std::vector<std::string>({"b"}));
+    std::remove(path.c_str());
+}
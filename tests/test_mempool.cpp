@@ -1,5 +1,8 @@
 #include "mempool.h"
 #include <gtest/gtest.h>
+#include <array>
+#include <memory>
+#include <string>
 
 using namespace NMemory;
 
@@ -72,4 +75,296 @@ TEST(TPool, String) {
     EXPECT_EQ(*s, '\0');                   // first block wasn't affected
     EXPECT_EQ(pool.BlocksCount(), 2ULL);   // we have 2 blocks
     EXPECT_STREQ(p, "Я рад за Вас");       // yeah, our string in the second block
-}
\ No newline at end of file
+}
+TEST(TPool, Alignment) {
+    TPool<> pool(64);
+    pool.Append("abc"); // 0+4=4, next double would be misaligned
+    double* d = pool.Append(3.14);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(d) % alignof(double), 0ULL);
+    EXPECT_EQ(*d, 3.14);
+
+    pool.Append("a");
+    struct alignas(32) T {
+        char x[24];
+    };
+    T* t = pool.Emplace<T>(); // the padding depends on the block address
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(t) % 32, 0ULL);
+
+    void* raw = pool.Allocate(1, 16);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(raw) % 16, 0ULL);
+}
+
+TEST(TPool, Emplace) {
+    TPool<> pool;
+    auto* p = pool.Emplace<std::unique_ptr<int>>(std::make_unique<int>(42)); // move only
+    EXPECT_EQ(**p, 42);
+
+    struct T {
+        int X;
+        std::string S;
+        T(int x, std::string s): X(x), S(std::move(s)) {}
+    };
+    T* t = pool.Emplace<T>(7, std::string(100, 'x')); // not an SSO string
+    EXPECT_EQ(t->X, 7);
+    EXPECT_EQ(t->S, std::string(100, 'x'));
+}
+
+TEST(TPool, AppendN) {
+    TPool<> pool(64);
+    std::span<ui32> a = pool.AppendN<ui32>(10);
+    EXPECT_EQ(a.size(), 10ULL);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a.data()) % alignof(ui32), 0ULL);
+    for(ui32 i=0; i<a.size(); ++i)
+        a[i] = i;
+    std::span<std::array<ui32, 2>> b = pool.AppendN<std::array<ui32, 2>>(3);
+    EXPECT_GE(reinterpret_cast<char*>(b.data()), reinterpret_cast<char*>(a.data() + a.size()));
+    EXPECT_EQ(a[9], 9U);
+    EXPECT_THROW(pool.AppendN<ui64>(std::numeric_limits<size_t>::max() / 4), std::bad_alloc);
+}
+
+TEST(TPool, TryExtend) {
+    TPool<> pool(64);
+    char* s = pool.Append("abc", 3);
+    EXPECT_TRUE(pool.TryExtend(s, 3, 6));
+    std::memcpy(s + 3, "def", 3);
+    char* t = pool.Append("x", 1);
+    EXPECT_EQ(t, s + 6); // the extended bytes are taken
+    EXPECT_FALSE(pool.TryExtend(s, 6, 8)); // not the last one anymore
+    EXPECT_TRUE(pool.TryExtend(t, 1, 58));
+    EXPECT_FALSE(pool.TryExtend(t, 58, 59)); // the block is full
+    EXPECT_TRUE(pool.TryExtend(t, 58, 2)); // shrinking
+    EXPECT_EQ(std::string(s, 7), "abcdefx");
+    EXPECT_EQ(pool.Append("y", 1), t + 2);
+}
+
+TEST(TPool, Destructors) {
+    std::vector<int> order;
+    struct T {
+        std::vector<int>& Order;
+        int Id;
+        ~T() { Order.push_back(Id); }
+    };
+    {
+        TPool<> pool(64);
+        for(int i=0; i<10; ++i) // several blocks
+            pool.Emplace<T>(order, i);
+        EXPECT_TRUE(order.empty());
+
+        pool.ReAllocate();
+        EXPECT_EQ(order, std::vector<int>({9, 8, 7, 6, 5, 4, 3, 2, 1, 0}));
+        EXPECT_EQ(pool.BlocksCount(), 1ULL);
+
+        order.clear();
+        pool.Emplace<T>(order, 11);
+        pool.Emplace<T>(order, 12);
+        pool.Append(T{order, -1}); // not registered, the temporary one reports -1
+    }
+    EXPECT_EQ(order, std::vector<int>({-1, 12, 11}));
+}
+
+TEST(TPool, Rewind) {
+    TPool<> pool(64);
+    pool.Append("persistent");
+    auto mark = pool.Mark();
+    char* first = pool.Append("scratch");
+    for(ui32 i=0; i<10; ++i)
+        pool.Emplace<ui64>(i); // 80 bytes -> new blocks
+    size_t blocks = pool.BlocksCount();
+    EXPECT_GT(blocks, 1ULL);
+
+    pool.Rewind(mark);
+    EXPECT_EQ(pool.Append("scratch"), first); // the same place again
+    for(ui32 i=0; i<10; ++i)
+        pool.Emplace<ui64>(i);
+    EXPECT_EQ(pool.BlocksCount(), blocks);    // kept blocks have been reused
+
+    pool.Reset();
+    EXPECT_STREQ(pool.Append("again"), "again");
+    EXPECT_EQ(pool.BlocksCount(), blocks);
+}
+
+TEST(TPool, Scope) {
+    std::vector<int> order;
+    struct T {
+        std::vector<int>& Order;
+        int Id;
+        ~T() { Order.push_back(Id); }
+    };
+    TPool<TExponentialStrategy> pool(64);
+    pool.Emplace<T>(order, 1);
+    void* top = nullptr;
+    size_t blocks = 0;
+    for(ui32 request=0; request<3; ++request) {
+        TPool<TExponentialStrategy>::TScope scope(pool);
+        void* p = pool.Emplace<T>(order, 2);
+        for(ui32 i=0; i<4; ++i)
+            pool.Emplace<std::string>(100, 'x');
+        if (request != 0) {
+            EXPECT_EQ(p, top);
+            EXPECT_EQ(pool.BlocksCount(), blocks);
+        }
+        top = p; blocks = pool.BlocksCount();
+    }
+    EXPECT_EQ(order, std::vector<int>({2, 2, 2}));
+    EXPECT_GT(blocks, 1ULL);
+
+    pool.Reset();
+    EXPECT_EQ(order, std::vector<int>({2, 2, 2, 1}));
+}
+
+TEST(TPool, Large) {
+    TPool<> pool(64);
+    char* s = pool.Append("small");
+    std::string big(1000, 'x');
+    char* b = pool.Append(big.c_str(), big.size() + 1); // used to throw
+    EXPECT_EQ(std::string(b), big);
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+    EXPECT_EQ(pool.LargeCount(), 1ULL);
+    EXPECT_STREQ(pool.Append("next"), "next");
+    EXPECT_EQ(pool.Append("x") - s, 11); // the block goes on after "small", "next"
+
+    auto mark = pool.Mark();
+    void* p = pool.Allocate(4096, 256);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 256, 0ULL);
+    pool.SetLargeSize(16); // small, but above the threshold
+    pool.Append("a string of 27 characters");
+    EXPECT_EQ(pool.LargeCount(), 3ULL);
+    pool.Rewind(mark);
+    EXPECT_EQ(pool.LargeCount(), 1ULL);
+
+    pool.ReAllocate();
+    EXPECT_EQ(pool.LargeCount(), 0ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 64ULL);
+
+    // size + align - 1 overflows: it must fail, not become a tiny reservation
+    EXPECT_THROW(pool.Allocate(std::numeric_limits<size_t>::max() - 2, 16), std::bad_alloc);
+    EXPECT_THROW(pool.Append(std::numeric_limits<size_t>::max()), std::bad_alloc);
+    EXPECT_EQ(pool.LargeCount(), 0ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 64ULL);
+}
+
+TEST(TPool, Bounded) {
+    TPool<TBoundedExponentialStrategy<64>> pool(16);
+    for(ui32 i=0; i<10; ++i)
+        pool.Append(std::array<char, 16>()); // 1(16/16) 2(32/32) 3(64/64) 4(48/64)
+    EXPECT_EQ(pool.BlocksCount(), 4ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 16ULL + 32 + 64 + 64);
+}
+
+TEST(TPool, Budget) {
+    TPool<TExponentialStrategy> pool(64);
+    pool.SetBudget(64 + 128);
+    pool.Append(std::array<char, 64>());
+    pool.Append(std::array<char, 64>()); // the second block (128 bytes)
+    EXPECT_THROW(pool.Allocate(1000), std::bad_alloc);
+    EXPECT_EQ(pool.LargeCount(), 0ULL);
+    pool.Append(std::array<char, 64>());
+    EXPECT_THROW(pool.Append(std::array<char, 64>()), std::bad_alloc); // the third block is out of budget
+    EXPECT_EQ(pool.BlocksCount(), 2ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 192ULL);
+
+    pool.Reset(); // blocks are kept, so no new memory is needed
+    for(ui32 i=0; i<3; ++i)
+        pool.Append(std::array<char, 64>());
+    EXPECT_EQ(pool.ReservedBytes(), 192ULL);
+
+    pool.SetBudget(100); // below what is already reserved
+    EXPECT_THROW(pool.Allocate(1000), std::bad_alloc);
+    EXPECT_THROW(pool.Append(std::array<char, 64>()), std::bad_alloc);
+    EXPECT_EQ(pool.ReservedBytes(), 192ULL);
+}
+
+TEST(TPool, RightSize) {
+    TPool<> pool(64);
+    auto cycle = [&pool]() {
+        for(ui32 i=0; i<100; ++i)
+            pool.Append(std::array<char, 32>());
+    };
+    cycle();
+    EXPECT_EQ(pool.BlocksCount(), 50ULL);
+    EXPECT_EQ(pool.HighWatermark(), 3200ULL);
+
+    pool.RightSize();
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 4096ULL);
+    EXPECT_EQ(pool.HighWatermark(), 0ULL);
+    cycle();
+    EXPECT_EQ(pool.BlocksCount(), 1ULL); // no Grow() at all
+
+    pool.Reset();
+    pool.Append(std::array<char, 32>());
+    EXPECT_EQ(pool.HighWatermark(), 3200ULL); // remembered over Reset()
+    pool.RightSize();
+    EXPECT_EQ(pool.ReservedBytes(), 4096ULL); // the block is kept
+
+    pool.ReAllocate();
+    EXPECT_EQ(pool.ReservedBytes(), 64ULL);
+}
+
+TEST(TPool, RightSizeExactBlock) {
+    TPool<> pool(64);
+    pool.Append(std::array<char, 32>());
+    pool.Append(std::array<char, 32>());
+    EXPECT_EQ(pool.HighWatermark(), 64ULL); // exactly one block
+    pool.RightSize();
+    EXPECT_EQ(pool.ReservedBytes(), 64ULL);
+
+    for(ui32 i=0; i<4; ++i)
+        pool.Append(std::array<char, 32>());
+    EXPECT_EQ(pool.HighWatermark(), 128ULL);
+    pool.RightSize();
+    EXPECT_EQ(pool.ReservedBytes(), 128ULL); // a power of two isn't doubled
+    for(ui32 i=0; i<4; ++i)
+        pool.Append(std::array<char, 32>());
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+}
+
+TEST(TPool, RetainAndTrim) {
+    TPool<TExponentialStrategy> pool(64);
+    for(ui32 i=0; i<20; ++i)
+        pool.Append(std::array<char, 64>()); // 64, 128, 256, 512, 1024
+    EXPECT_EQ(pool.BlocksCount(), 5ULL);
+
+    pool.Retain(2);
+    EXPECT_EQ(pool.BlocksCount(), 2ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 1024ULL + 512);
+    for(ui32 i=0; i<20; ++i)
+        pool.Append(std::array<char, 64>()); // 16 go to the largest block
+    EXPECT_EQ(pool.BlocksCount(), 2ULL);
+
+    pool.Reset();
+    pool.Append(std::array<char, 64>());
+    pool.Trim();
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+    EXPECT_EQ(pool.ReservedBytes(), 1024ULL);
+}
+
+TEST(TPool, Stats) {
+    EXPECT_EQ(TStats::Bucket(0), 0ULL);
+    EXPECT_EQ(TStats::Bucket(1), 0ULL);
+    EXPECT_EQ(TStats::Bucket(2), 1ULL);
+    EXPECT_EQ(TStats::Bucket(16), 4ULL);
+    EXPECT_EQ(TStats::Bucket(17), 5ULL);
+    EXPECT_EQ(TStats::Bucket(1ULL << 40), TStats::BucketsCount - 1);
+
+    TPool<> pool(32);
+    pool.Append("Hello");          // 6
+    pool.Append("world, world!!"); // 15 -> 21/32
+    pool.Append("a long string");  // 14 -> the second block, 11 bytes of tail waste
+    pool.Allocate(100);            // large
+    TStats s = pool.Stats();
+    EXPECT_EQ(s.Requested, 6ULL + 15 + 14 + 100);
+    EXPECT_EQ(s.Allocations, 4ULL);
+    EXPECT_EQ(s.Buckets[3], 1ULL);
+    EXPECT_EQ(s.Buckets[4], 2ULL);
+    EXPECT_EQ(s.Buckets[7], 1ULL);
+    EXPECT_EQ(s.TailWaste, 11ULL);
+    EXPECT_EQ(s.Reserved, pool.ReservedBytes());
+    EXPECT_EQ(s.Peak, s.Reserved);
+
+    pool.ReAllocate();
+    s = pool.Stats();
+    EXPECT_EQ(s.Reserved, 32ULL);
+    EXPECT_EQ(s.TailWaste, 0ULL);
+    EXPECT_GT(s.Peak, s.Reserved);
+}
@@ -0,0 +1,45 @@
+#include "mmapsource.h"
+#include "mempool.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace NMemory;
+
+
+TEST(TMmapBlockSource, Sizes) {
+    size_t size = 100;
+    char* p = TMmapBlockSource<false>::Allocate(size);
+    EXPECT_EQ(size, size_t(sysconf(_SC_PAGESIZE)));
+    std::memset(p, 1, size);
+    TMmapBlockSource<false>::DeAllocate(p, size);
+
+    size = TMmapBlockSource<>::HugePageSize + 1;
+    p = TMmapBlockSource<true, true>::Allocate(size);
+    EXPECT_EQ(size, 2 * TMmapBlockSource<>::HugePageSize);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % TMmapBlockSource<>::HugePageSize, 0ULL);
+    std::memset(p, 1, size);
+    TMmapBlockSource<>::DeAllocate(p, size);
+}
+
+TEST(TMmapBlockSource, Pool) {
+    TPool<TExponentialStrategy, TMmapBlockSource<false, true>> pool(16);
+    char* s = pool.Append("Hello");
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+    for(ui32 i=0; i<1000; ++i)
+        pool.Emplace<std::string>(100, 'x'); // destructors registered
+    EXPECT_STREQ(s, "Hello");
+    EXPECT_GT(pool.BlocksCount(), 1ULL);
+
+    pool.ReAllocate(); // unmaps everything
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+    EXPECT_STREQ(pool.Append("world"), "world");
+}
+
+TEST(TMmapBlockSource, HugePool) {
+    TPool<TLinearStrategy, TMmapBlockSource<>> pool(TMmapBlockSource<>::HugePageSize);
+    ui64* x = static_cast<ui64*>(pool.Allocate(sizeof(ui64) * 100000));
+    for(ui32 i=0; i<100000; ++i)
+        x[i] = i;
+    EXPECT_EQ(x[99999], 99999ULL);
+    EXPECT_EQ(pool.BlocksCount(), 1ULL);
+}
@@ -0,0 +1,66 @@
+#include "offsetpool.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace NMemory;
+
+
+TEST(TOffsetPool, Allocate) {
+    TOffsetPool<> pool(4 << 20);
+    EXPECT_EQ(pool.CommittedBytes(), 0ULL); // only reserved
+
+    ui32 a = pool.Allocate(1);
+    ui32 b = pool.Allocate(16, 16);
+    EXPECT_NE(a, 0U); // 0 is null
+    EXPECT_GT(b, a);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(pool.Ptr(b)) % 16, 0ULL);
+    EXPECT_EQ(pool.CommittedBytes(), 1ULL << 20);
+
+    pool.Allocate(2 << 20);
+    EXPECT_EQ(pool.CommittedBytes(), 3ULL << 20);
+    EXPECT_THROW(pool.Allocate(2 << 20), std::bad_alloc);
+
+    pool.Reset();
+    EXPECT_EQ(pool.Allocate(1), a);
+    EXPECT_EQ(pool.CommittedBytes(), 3ULL << 20);
+}
+
+TEST(TOffsetPool, CompactTree) {
+    struct TNode {
+        TOffset<TNode> Left, Right;
+        ui32 Key;
+    };
+    static_assert(sizeof(TNode) == 12);
+
+    TOffsetPool<4> pool;
+    TOffset<TNode> root;
+    auto insert = [&](ui32 key) {
+        TOffset<TNode>* link = &root;
+        while(*link) {
+            TNode& n = pool[*link];
+            link = key < n.Key ? &n.Left : &n.Right;
+        }
+        *link = pool.Emplace<TNode>(TOffset<TNode>{}, TOffset<TNode>{}, key);
+    };
+    auto exists = [&](ui32 key) {
+        for(TOffset<TNode> cur = root; cur; ) {
+            const TNode& n = pool[cur];
+            if (n.Key == key)
+                return true;
+            cur = key < n.Key ? n.Left : n.Right;
+        }
+        return false;
+    };
+
+    std::mt19937 rng(42);
+    std::vector<ui32> keys;
+    for(ui32 i=0; i<100000; ++i)
+        keys.push_back(rng() | 1);
+    for(ui32 k: keys)
+        insert(k);
+    for(ui32 k: keys)
+        EXPECT_TRUE(exists(k));
+    EXPECT_FALSE(exists(2));
+    EXPECT_EQ(pool.Size(), 4 + keys.size() * sizeof(TNode));
+    EXPECT_EQ(pool.OffsetOf(pool.Get(root)), root);
+}
@@ -0,0 +1,41 @@
+#include "poolresource.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace NMemory;
+
+
+TEST(TPoolResource, Small) {
+    TPoolResource<> arena(1024, 256, std::pmr::null_memory_resource()); // upstream must not be touched
+    std::pmr::vector<std::pmr::string> v(&arena);
+    v.reserve(4);
+    for(ui32 i=0; i<4; ++i)
+        v.emplace_back(std::string(50, 'a'+i)); // not an SSO string
+    EXPECT_EQ(std::string_view(v[3]), std::string(50, 'd'));
+    EXPECT_EQ(v.get_allocator().resource(), &arena);
+    EXPECT_EQ(v[3].get_allocator().resource(), &arena);
+    EXPECT_EQ(arena.Pool().BlocksCount(), 1ULL);
+
+    void* p = arena.allocate(7, 64);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 64, 0ULL);
+    arena.deallocate(p, 7, 64); // no-op
+}
+
+TEST(TPoolResource, Large) {
+    TPoolResource<> arena(1024, 256, std::pmr::null_memory_resource());
+    EXPECT_THROW((void)arena.allocate(257), std::bad_alloc); // upstream has been called
+
+    TPoolResource<> arena2(1024, 256);
+    std::pmr::vector<ui32> v(&arena2);
+    for(ui32 i=0; i<100000; ++i) // vector buffers > 256 bytes come from upstream
+        v.push_back(i);
+    EXPECT_EQ(v.back(), 99999U);
+    EXPECT_EQ(arena2.Pool().BlocksCount(), 1ULL);
+}
+
+TEST(TPoolResource, IsEqual) {
+    TPoolResource<> a1, a2;
+    EXPECT_TRUE(a1.is_equal(a1));
+    EXPECT_FALSE(a1.is_equal(a2));
+}
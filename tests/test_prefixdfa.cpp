@@ -1,4 +1,5 @@
 #include "prefixdfa.h"
+#include "poolresource.h"
 #include <gtest/gtest.h>
 
 using namespace NPrefix;
@@ -97,4 +98,17 @@ TEST(TPrefixDfa, EraseAll) {
 
     dfa.insert("these");
     EXPECT_TRUE(dfa.exists("these"));
-}
\ No newline at end of file
+}
+TEST(TPrefixDfa, Pmr) {
+    NMemory::TPoolResource<> arena;
+    NPmr::TDfa dfa(&arena);
+    dfa.insert("she");
+    dfa.insert("sea");
+    dfa.insert("shell");
+    dfa.erase("sea");
+
+    EXPECT_TRUE(dfa.exists("she"));
+    EXPECT_FALSE(dfa.exists("sea"));
+    EXPECT_TRUE(dfa.exists("shell"));
+    EXPECT_EQ(dfa.size(), 2U);
+}
@@ -0,0 +1,127 @@
+#include "prefixmap.h"
+#include "poolresource.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+using namespace NPrefix;
+
+
+TEST(TPrefixMap, Basic) {
+    TMap<ui32> map;
+    EXPECT_TRUE(map.Insert("she", 1));
+    EXPECT_TRUE(map.Insert("sells", 2));
+    EXPECT_TRUE(map.Insert("sea", 3));
+    EXPECT_FALSE(map.Insert("sea", 4));
+    EXPECT_EQ(map.Find("sea"), 3U);
+    EXPECT_FALSE(map.Upsert("sea", 5));
+    EXPECT_EQ(map.Find("sea"), 5U);
+    EXPECT_TRUE(map.Upsert("s", 6));
+    EXPECT_FALSE(map.Find("se"));
+    EXPECT_FALSE(map.Find("seas"));
+
+    EXPECT_TRUE(map.Update("shore", [](ui32& v) { v += 10; }));
+    EXPECT_FALSE(map.Update("shore", [](ui32& v) { v += 10; }));
+    EXPECT_EQ(map.Find("shore"), 20U);
+
+    std::vector<std::pair<std::string, ui32>> all;
+    for(auto it=map.KeysWithPrefix("s"); it; ++it)
+        all.emplace_back(it.Key(), it.Value());
+    EXPECT_EQ(all, (std::vector<std::pair<std::string, ui32>>{{"s", 6}, {"sea", 5}, {"sells", 2}, {"she", 1}, {"shore", 20}}));
+
+    EXPECT_TRUE(map.Remove("sells"));
+    EXPECT_TRUE(map.Remove("s"));
+    EXPECT_FALSE(map.Remove("s"));
+    EXPECT_EQ(map.Find("sea"), 5U); // joined with its parent edge, the value goes along
+    EXPECT_EQ(map.Find("she"), 1U);
+    EXPECT_EQ(map.size(), 3U);
+}
+
+TEST(TPrefixMap, LongestPrefixOf) {
+    TMap<ui32> routes;
+    routes.Insert("/", 1);
+    routes.Insert("/api/", 2);
+    routes.Insert("/api/v2/", 3);
+    EXPECT_EQ(routes.LongestPrefixOf("/api/v2/users"), std::make_pair(std::string_view("/api/v2/"), 3U));
+    EXPECT_EQ(routes.LongestPrefixOf("/api/v1/users"), std::make_pair(std::string_view("/api/"), 2U));
+    EXPECT_EQ(routes.LongestPrefixOf("/index.html"), std::make_pair(std::string_view("/"), 1U));
+    EXPECT_FALSE(routes.LongestPrefixOf("api"));
+}
+
+TEST(TPrefixMap, Random) {
+    struct TPoint {
+        i32 X;
+        i16 Y;
+        bool operator==(const TPoint&) const = default;
+    };
+    TMap<TPoint> map;
+    std::map<std::string, TPoint> oracle;
+    std::mt19937 rng(9);
+    for(ui32 i=0; i<20000; ++i) {
+        std::string w(rng() % 10 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 3;
+        const TPoint p{i32(rng()), i16(i)};
+        switch(rng() % 4) {
+            case 0:
+                EXPECT_EQ(map.Remove(w), oracle.erase(w) == 1);
+                break;
+            case 1:
+                EXPECT_EQ(map.Insert(w, p), oracle.emplace(w, p).second);
+                break;
+            default:
+                EXPECT_EQ(map.Upsert(w, p), oracle.insert_or_assign(w, p).second);
+        }
+    }
+    EXPECT_EQ(map.size(), oracle.size());
+    auto it = map.AllKeys();
+    for(const auto& [key, value]: oracle) {
+        ASSERT_TRUE(it);
+        EXPECT_EQ(it.Key(), key);
+        EXPECT_EQ(it.Value(), value);
+        EXPECT_EQ(map.Find(key), value);
+        ++it;
+    }
+    EXPECT_FALSE(it);
+}
+
+TEST(TPrefixMap, RemoveCompactsLongLabels) {
+    std::mt19937 rng(12);
+    std::map<std::string, ui64> oracle;
+    TMap<ui64> map;
+    for(ui64 i=0; i<20000; ++i) {
+        std::string w(rng() % 20 + 6, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 4;
+        map.Upsert(w, i);
+        oracle.insert_or_assign(w, i);
+    }
+    ui32 i = 0;
+    for(auto it=oracle.begin(); it!=oracle.end();)
+        if (i++ % 3 != 0) { // enough garbage for the pool to be compacted
+            EXPECT_TRUE(map.Remove(it->first));
+            it = oracle.erase(it);
+        } else {
+            ++it;
+        }
+    EXPECT_EQ(map.size(), oracle.size());
+    auto it = map.AllKeys();
+    for(const auto& [key, value]: oracle) {
+        ASSERT_TRUE(it);
+        EXPECT_EQ(it.Key(), key);
+        EXPECT_EQ(it.Value(), value);
+        EXPECT_EQ(map.Find(key), value);
+        ++it;
+    }
+    EXPECT_FALSE(it);
+}
+
+TEST(TPrefixMap, Pmr) {
+    NMemory::TPoolResource<> arena;
+    NPmr::TMap<ui64> map(&arena);
+    for(ui64 i=0; i<1000; ++i)
+        map.Insert("key" + std::to_string(i), i * i);
+    for(ui64 i=0; i<1000; ++i)
+        EXPECT_EQ(map.Find("key" + std::to_string(i)), i * i);
+    EXPECT_EQ(map.LowerBound("key999").Value(), 999U * 999U);
+}
@@ -1,5 +1,10 @@
 #include "prefixtree.h"
+#include "poolresource.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <set>
 
 using namespace NPrefix;
 
@@ -60,6 +65,38 @@ TEST(TPrefixTree, Remove) {
     tree.Remove("baca");
     EXPECT_EQ(tree.size(), 0U);
 }
+TEST(TPrefixTree, RemoveJoinSubtree) {
+    TTree tree;
+    tree.Append("ab");
+    tree.Append("acd");
+    tree.Append("ace");
+    tree.Remove("ab"); // "a" and "c" are joined, "c" has the subtree {d,e}
+    EXPECT_TRUE(tree.Exists("acd"));
+    EXPECT_TRUE(tree.Exists("ace"));
+    EXPECT_EQ(tree.InOrder(), V("ac", E("d"), E("e")));
+}
+TEST(TPrefixTree, LongLabels) {
+    TTree tree;
+    const std::string p = "prefix_longer_than_inline_";
+    for(ui32 i=0; i<1000; ++i)
+        tree.Append(p + std::to_string(i) + "_suffix_longer_than_inline");
+    size_t bytes = tree.LabelBytes();
+    EXPECT_GT(bytes, 0ULL);
+    for(ui32 i=0; i<1000; ++i)
+        EXPECT_TRUE(tree.Exists(p + std::to_string(i) + "_suffix_longer_than_inline"));
+
+    for(ui32 i=0; i<1000; ++i)
+        if (i % 4 != 3) {
+            EXPECT_TRUE(tree.Remove(p + std::to_string(i) + "_suffix_longer_than_inline"));
+        }
+    EXPECT_LT(tree.LabelBytes(), bytes / 2); // compacted
+    for(ui32 i=0; i<1000; ++i)
+        EXPECT_EQ(tree.Exists(p + std::to_string(i) + "_suffix_longer_than_inline"), i % 4 == 3);
+    ui32 len = 0;
+    for(auto it=tree.KeysWithPrefix(p + "99"); it; ++it, ++len)
+        EXPECT_EQ(it.Key().substr(0, p.size() + 2), p + "99");
+    EXPECT_EQ(len, 4U); // 99, 991, 995, 999
+}
 TEST(TPrefixTree, RemoveRealWords) {
     TTree tree;
     tree.Append("she");
@@ -129,3 +166,351 @@ TEST(TPrefixTree, KeysWithPrefixRoot) {
     EXPECT_EQ((++it).Key(), "bc");
     EXPECT_FALSE(bool(++it));
 }
+
+TEST(TPrefixTree, WideNode) {
+    TTree tree;
+    std::vector<std::string> keys;
+    for(ui32 b=255; b>0; --b) // more children than a SIMD lane, bytes >= 0x80 too
+        keys.push_back(std::string("x") + char(b));
+    for(const auto& k: keys)
+        EXPECT_TRUE(tree.Append(k));
+    for(const auto& k: keys)
+        EXPECT_TRUE(tree.Exists(k));
+    EXPECT_FALSE(tree.Exists("x"));
+
+    std::sort(keys.begin(), keys.end()); // std::string order is the unsigned one
+    std::vector<std::string> all;
+    for(auto it=tree.AllKeys(); it; ++it)
+        all.push_back(it.Key());
+    EXPECT_EQ(all, keys);
+
+    for(ui32 i=0; i<keys.size(); i+=2)
+        EXPECT_TRUE(tree.Remove(keys[i]));
+    for(ui32 i=0; i<keys.size(); ++i)
+        EXPECT_EQ(tree.Exists(keys[i]), i % 2 == 1);
+    EXPECT_EQ(tree.KeysWithPrefix(std::string("x") + char(0xF2)).Key(), std::string("x") + char(0xF2));
+}
+
+TEST(TPrefixTree, BuildFromSorted) {
+    std::vector<std::string> keys = {"by", "s", "sea", "sea", "sells", "she", "shells", "shore", "the"};
+    TTree tree;
+    tree.Append("old");
+    tree.BuildFromSorted(keys);
+    EXPECT_EQ(tree.size(), 8U);
+    EXPECT_FALSE(tree.Exists("old"));
+    EXPECT_EQ(tree.InOrder(), V(E("by"), "s", E(), "e", E("a"), E("lls"), "h", "e", E(), E("lls"), E("ore"), E("the")));
+
+    std::mt19937 rng(7);
+    std::vector<std::string> words;
+    for(ui32 i=0; i<20000; ++i) {
+        std::string w(rng() % 10 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 3 + (rng() % 16 == 0 ? 0x80 : 0); // bytes >= 0x80 too
+        words.push_back(w);
+    }
+    TTree appended;
+    for(const auto& w: words)
+        appended.Append(w);
+    TTree built;
+    built.BuildFromUnsorted(words, 4);
+    EXPECT_EQ(built.size(), appended.size());
+    EXPECT_EQ(built.InOrder(), appended.InOrder());
+    EXPECT_TRUE(built.Remove(words[0]));
+    EXPECT_FALSE(built.Exists(words[0]));
+    EXPECT_TRUE(built.Append(words[0]));
+
+    EXPECT_THROW(tree.BuildFromSorted(std::vector<std::string>({"b", "a"})), std::invalid_argument);
+    EXPECT_EQ(tree.size(), 0U);
+}
+
+TEST(TPrefixTree, BuildParallel) {
+    std::mt19937 rng(8);
+    std::vector<std::string> words{""};
+    for(ui32 i=0; i<30000; ++i) {
+        std::string w(rng() % 20 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 4 + (rng() % 16 == 0 ? 0x80 : 0);
+        words.push_back(w);
+    }
+    TTree appended;
+    for(const auto& w: words)
+        appended.Append(w);
+    for(ui32 threads: {1U, 4U}) {
+        TTree built;
+        built.Append("old");
+        built.BuildParallel(words, threads);
+        EXPECT_EQ(built.size(), appended.size());
+        EXPECT_EQ(built.InOrder(), appended.InOrder());
+        EXPECT_TRUE(built.Exists(""));
+        // labels are read from the merged pool, removals compact it
+        std::set<std::string> removed;
+        for(size_t i=0; i<words.size(); i+=2) {
+            built.Remove(words[i]);
+            removed.insert(words[i]);
+        }
+        for(const auto& w: words)
+            EXPECT_EQ(built.Exists(w), !removed.count(w)) << w;
+    }
+}
+
+TEST(TPrefixTree, LabelBytesLimit) {
+    // the serial and the parallel builds check the merged pool against ui32 offsets
+    EXPECT_NO_THROW(CheckLabelBytes(std::numeric_limits<ui32>::max()));
+    EXPECT_THROW(CheckLabelBytes(size_t(std::numeric_limits<ui32>::max()) + 1), std::length_error);
+}
+
+TEST(TPrefixTree, ExistsBatch) {
+    std::mt19937 rng(10);
+    TTree tree;
+    tree.Append("");
+    std::vector<std::string> queries;
+    for(ui32 i=0; i<5000; ++i) {
+        std::string w(rng() % 12, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 3 + (rng() % 16 == 0 ? 0x80 : 0);
+        if (rng() % 2)
+            tree.Append(w);
+        queries.push_back(w);
+    }
+    for(size_t n: {size_t(0), size_t(5), queries.size()}) {
+        std::vector<std::string_view> keys(queries.begin(), queries.begin() + n);
+        std::unique_ptr<bool[]> found(new bool[n + 1]);
+        tree.ExistsBatch(keys, std::span<bool>(found.get(), n));
+        for(size_t i=0; i<n; ++i)
+            EXPECT_EQ(found[i], tree.Exists(queries[i])) << queries[i];
+    }
+    bool found[2] = {true, true};
+    TTree().ExistsBatch(std::vector<std::string_view>{"a", ""}, found);
+    EXPECT_FALSE(found[0] || found[1]);
+}
+
+TEST(TPrefixTree, Cursor) {
+    TTree tree;
+    for(auto key: {"she", "sells", "sea", "shells", "by", "the", "shore", "s", "a long word out of a short label"})
+        tree.Append(std::string(key));
+    auto keys = [&tree](std::string_view prefix) {
+        std::vector<std::string> keys;
+        for(auto cursor = tree.CursorWithPrefix(prefix); cursor; ++cursor)
+            keys.push_back(std::string(cursor.Key()));
+        return keys;
+    };
+    auto expected = [&tree](const std::string& prefix) {
+        std::vector<std::string> keys;
+        for(auto it = tree.AllKeys(); it; ++it)
+            if (it.Key().starts_with(prefix))
+                keys.push_back(it.Key());
+        return keys;
+    };
+    for(auto prefix: {"", "s", "sh", "she", "shel", "shells", "shellsx", "a long", "a long word out of a short label", "x", "t"})
+        EXPECT_EQ(keys(prefix), expected(prefix)) << prefix;
+
+    TTree::TCursor cursor(tree);
+    cursor.Seek("x");
+    EXPECT_FALSE(cursor);
+    cursor.Seek("se"); // the buffer is reused
+    EXPECT_EQ(cursor.Key(), "sea");
+    EXPECT_EQ((++cursor).Key(), "sells");
+    EXPECT_FALSE(++cursor);
+
+    std::vector<std::string> first;
+    tree.ForEachWithPrefix("s", [&first](std::string_view key) {
+        first.emplace_back(key);
+        return first.size() < 2;
+    });
+    EXPECT_EQ(first, std::vector<std::string>({"s", "sea"}));
+    size_t count = 0;
+    tree.ForEachWithPrefix("", [&count](std::string_view) { ++count; });
+    EXPECT_EQ(count, tree.size());
+}
+
+TEST(TPrefixTree, Bounds) {
+    std::mt19937 rng(3);
+    std::set<std::string> set;
+    TTree tree;
+    for(ui32 i=0; i<3000; ++i) {
+        std::string w(rng() % 6 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 3 + (rng() % 16 == 0 ? 0x80 : 0);
+        set.insert(w);
+        tree.Append(w);
+    }
+    auto first = [](const TTree::TCursor& cursor) {
+        return cursor ? std::string(cursor.Key()) : std::string("<end>");
+    };
+    auto expected = [&set](std::set<std::string>::const_iterator it) {
+        return it == set.end() ? std::string("<end>") : *it;
+    };
+    for(ui32 i=0; i<2000; ++i) {
+        std::string x(rng() % 7, 'a');
+        for(auto& c: x)
+            c = 'a' + rng() % 4 + (rng() % 16 == 0 ? 0x80 : 0);
+        EXPECT_EQ(first(tree.LowerBound(x)), expected(set.lower_bound(x))) << x;
+        EXPECT_EQ(first(tree.UpperBound(x)), expected(set.upper_bound(x))) << x;
+    }
+    for(const auto& x: {std::string("abc"), std::string("a"), std::string("")}) {
+        std::vector<std::string> all;
+        for(auto cursor = tree.LowerBound(x); cursor; ++cursor)
+            all.emplace_back(cursor.Key());
+        EXPECT_EQ(all, std::vector<std::string>(set.lower_bound(x), set.end()));
+    }
+
+    std::vector<std::string> range;
+    for(auto cursor = tree.Range("ab", "b"); cursor; ++cursor)
+        range.emplace_back(cursor.Key());
+    EXPECT_EQ(range, std::vector<std::string>(set.lower_bound("ab"), set.lower_bound("b")));
+    EXPECT_FALSE(tree.Range("b", "b"));
+    EXPECT_FALSE(tree.Range("c", "b"));
+
+    TTree words;
+    for(auto key: {"by", "s", "sea", "sells", "she", "shells", "shore", "the"})
+        words.Append(std::string(key));
+    EXPECT_EQ(words.LowerBound("she").Key(), "she");
+    EXPECT_EQ(words.UpperBound("she").Key(), "shells");
+    EXPECT_EQ(words.LowerBound("shf").Key(), "shore");
+    EXPECT_EQ(words.LowerBound("c").Key(), "s");
+    EXPECT_FALSE(words.UpperBound("the"));
+}
+
+TEST(TPrefixTree, PrefixesOf) {
+    TTree words;
+    for(auto key: {"", "s", "sea", "seashell", "she", "shells"})
+        words.Append(std::string(key));
+    using TViews = std::vector<std::string_view>;
+    EXPECT_EQ(words.AllPrefixesOf("seashells"), TViews({"", "s", "sea", "seashell"}));
+    EXPECT_EQ(words.AllPrefixesOf("shell"), TViews({"", "s", "she"}));
+    EXPECT_EQ(words.AllPrefixesOf("x"), TViews({""}));
+    EXPECT_EQ(words.LongestPrefixOf("seashore"), "sea");
+    EXPECT_EQ(words.LongestPrefixOf("shells"), "shells");
+    words.Remove("");
+    EXPECT_FALSE(words.LongestPrefixOf("x"));
+    EXPECT_FALSE(TTree().LongestPrefixOf("x"));
+
+    std::mt19937 rng(4);
+    std::set<std::string> set;
+    TTree tree;
+    for(ui32 i=0; i<3000; ++i) {
+        std::string w(rng() % 6 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 3 + (rng() % 16 == 0 ? 0x80 : 0);
+        set.insert(w);
+        tree.Append(w);
+    }
+    for(ui32 i=0; i<2000; ++i) {
+        std::string x(rng() % 9, 'a');
+        for(auto& c: x)
+            c = 'a' + rng() % 3 + (rng() % 16 == 0 ? 0x80 : 0);
+        TViews expected;
+        for(size_t n=0; n<=x.size(); ++n)
+            if (set.count(x.substr(0, n)))
+                expected.push_back(std::string_view(x).substr(0, n));
+        EXPECT_EQ(tree.AllPrefixesOf(x), expected) << x;
+        EXPECT_EQ(tree.LongestPrefixOf(x), expected.empty() ? std::nullopt : std::optional(expected.back())) << x;
+    }
+}
+
+static ui32 Levenshtein(std::string_view a, std::string_view b) {
+    std::vector<ui32> row(b.size() + 1);
+    for(size_t j=0; j<=b.size(); ++j)
+        row[j] = j;
+    for(size_t i=1; i<=a.size(); ++i) {
+        ui32 diag = row[0];
+        row[0] = i;
+        for(size_t j=1; j<=b.size(); ++j) {
+            const ui32 up = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diag + (a[i - 1] != b[j - 1])});
+            diag = up;
+        }
+    }
+    return row.back();
+}
+
+TEST(TPrefixTree, FuzzySearch) {
+    TTree words;
+    for(auto key: {"", "sea", "seal", "sell", "she", "shell", "shore"})
+        words.Append(std::string(key));
+    using TFound = std::vector<std::pair<std::string, ui32>>;
+    EXPECT_EQ(words.FuzzySearch("sel", 1), TFound({{"sea", 1}, {"seal", 1}, {"sell", 1}}));
+    EXPECT_EQ(words.FuzzySearch("shel", 0), TFound());
+    EXPECT_EQ(words.FuzzySearch("s", 1), TFound({{"", 1}}));
+    EXPECT_EQ(TTree().FuzzySearch("s", 3), TFound());
+
+    std::mt19937 rng(6);
+    std::set<std::string> set;
+    TTree tree;
+    for(ui32 i=0; i<3000; ++i) {
+        std::string w(rng() % 8 + 1, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 4 + (rng() % 16 == 0 ? 0x80 : 0);
+        set.insert(w);
+        tree.Append(w);
+    }
+    for(ui32 i=0; i<300; ++i) {
+        std::string x(rng() % 9, 'a');
+        for(auto& c: x)
+            c = 'a' + rng() % 4;
+        const ui32 k = rng() % 4;
+        TFound expected;
+        for(const auto& w: set)
+            if (const ui32 d = Levenshtein(w, x); d <= k)
+                expected.emplace_back(w, d);
+        EXPECT_EQ(tree.FuzzySearch(x, k), expected) << x << ' ' << k;
+    }
+}
+
+TEST(TPrefixTree, RemoveCompactsLongLabels) {
+    std::mt19937 rng(11);
+    std::set<std::string> set;
+    TTree tree;
+    for(ui32 i=0; i<20000; ++i) {
+        std::string w(rng() % 20 + 6, 'a');
+        for(auto& c: w)
+            c = 'a' + rng() % 4;
+        set.insert(w);
+        tree.Append(w);
+    }
+    const size_t bytes = tree.LabelBytes();
+    ui32 i = 0;
+    for(auto it=set.begin(); it!=set.end();)
+        if (i++ % 3 != 0) {
+            EXPECT_TRUE(tree.Remove(*it));
+            it = set.erase(it);
+        } else {
+            ++it;
+        }
+    EXPECT_LT(tree.LabelBytes(), bytes); // the pool was compacted
+    EXPECT_EQ(tree.size(), set.size());
+    std::vector<std::string> all;
+    for(auto it=tree.AllKeys(); it; ++it)
+        all.emplace_back(it.Key());
+    EXPECT_EQ(all, std::vector<std::string>(set.begin(), set.end()));
+    for(const auto& w: set)
+        EXPECT_TRUE(tree.Exists(w)) << w;
+}
+
+TEST(TPrefixTree, Pmr) {
+    NMemory::TPoolResource<> arena(4096, 1024, std::pmr::null_memory_resource());
+    {
+        NPmr::TTree tree(&arena);
+        tree.Append("she");
+        tree.Append("sells");
+        tree.Append("sea");
+        tree.Append("shells");
+        tree.Append("by");
+        tree.Append("the");
+        tree.Append("sea");
+        tree.Append("shore");
+        tree.Append("a very long word which doesn't fit into small string optimization");
+        EXPECT_EQ(tree.size(), 8U);
+        EXPECT_TRUE(tree.Exists("shells"));
+
+        tree.Remove("sea");
+        tree.Remove("shells");
+        EXPECT_FALSE(tree.Exists("sea"));
+        EXPECT_TRUE(tree.Exists("sells"));
+
+        ui32 len=0; // {sells,she,shore}
+        for(auto it=tree.KeysWithPrefix("s"); it; ++it) ++len;
+        EXPECT_EQ(len, 3U);
+    }
+    EXPECT_EQ(arena.Pool().BlocksCount(), 1ULL);
+}
@@ -97,6 +97,22 @@ TEST(TSet, Delete2) {
     EXPECT_EQ(keys, V({5,3,7,6,17}));
 }
 
+TEST(TSet, DeleteLeftLeaf) {
+    TSet<TKey> set;
+    for(TKey i=0; i<1000; ++i)
+        set.insert(i);
+    for(TKey i=0; i<1000; i+=2)
+        set.erase(i);
+    EXPECT_EQ(set.size(), 500U);
+
+    std::vector<TKey> keys;
+    set.InOrder(keys);
+    EXPECT_EQ(keys.size(), 500U);
+    for(ui32 i=0; i<keys.size(); ++i)
+        EXPECT_EQ(keys[i], TKey(2*i+1));
+    EXPECT_EQ(set.select(500).rank(), 500U);
+}
+
 TEST(TSet, Size) {
     TSet<TKey> set;
 
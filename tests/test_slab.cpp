@@ -0,0 +1,80 @@
+#include "slab.h"
+#include "rbset.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace NMemory;
+
+
+TEST(TSlab, Reuse) {
+    TSlab<> slab;
+    void* p1 = slab.Allocate(24); // class 32
+    void* p2 = slab.Allocate(32); // class 32
+    EXPECT_NE(p1, p2);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p1) % 16, 0ULL);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p2) % 16, 0ULL);
+
+    slab.DeAllocate(p1, 24);
+    slab.DeAllocate(p2, 32);
+    EXPECT_EQ(slab.Allocate(17), p2); // LIFO
+    EXPECT_EQ(slab.Allocate(30), p1);
+
+    void* p3 = slab.Allocate(8); // class 16, own free list
+    slab.DeAllocate(p3, 8);
+    EXPECT_NE(slab.Allocate(32), p3);
+    EXPECT_EQ(slab.Allocate(16), p3);
+}
+
+TEST(TSlab, Large) {
+    TSlab<TPool<>, 64> slab;
+    void* p = slab.Allocate(100); // ::operator new
+    std::memset(p, 0, 100);
+    slab.DeAllocate(p, 100);
+    EXPECT_EQ(slab.BlocksCount(), 1ULL);
+}
+
+TEST(TSlab, Blocks) {
+    TSlab<> slab(256);
+    std::vector<void*> ptrs;
+    for(ui32 i=0; i<64; ++i)
+        ptrs.push_back(slab.Allocate(32));
+    size_t blocks = slab.BlocksCount();
+    for(void* p: ptrs)
+        slab.DeAllocate(p, 32);
+    for(ui32 i=0; i<64; ++i)
+        slab.Allocate(32);
+    EXPECT_EQ(slab.BlocksCount(), blocks); // everything came from the free list
+}
+
+TEST(TSlabAllocator, RBTree) {
+    auto fill = [] {
+        NRBTree::TSet<ui32, TSlabAllocator<>> set;
+        for(ui32 i=0; i<1000; ++i)
+            set.insert(i);
+        for(ui32 i=0; i<1000; i+=2)
+            set.erase(i);
+        for(ui32 i=1000; i<1500; ++i)
+            set.insert(i);
+        EXPECT_EQ(set.size(), 1000U);
+        EXPECT_EQ(*set.begin(), 1U);
+        EXPECT_EQ(*set.select(1000), 1499U);
+    };
+    fill();
+    std::thread t(fill); // own thread-local slab
+    t.join();
+    EXPECT_NE(&TSlabAllocator<>::Local(), nullptr);
+}
+
+TEST(TSlab, Stats) {
+    TSlab<> slab(4096);
+    void* p = slab.Allocate(24);
+    slab.DeAllocate(p, 24);
+    slab.Allocate(24); // from the free list
+    slab.Allocate(1000);
+    TStats s = slab.Stats();
+    EXPECT_EQ(s.Allocations, 3ULL);
+    EXPECT_EQ(s.Requested, 24ULL + 24 + 1000);
+    EXPECT_EQ(s.Buckets[5], 2ULL);
+    EXPECT_EQ(s.Reserved, 4096ULL);
+}
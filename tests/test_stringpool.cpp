@@ -0,0 +1,41 @@
+#include "stringpool.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace NMemory;
+
+
+TEST(TStringPool, Intern) {
+    TStringPool<> strings;
+    ui32 a = strings.Intern("abc");
+    ui32 b = strings.Intern("abd");
+    ui32 e = strings.Intern("");
+    EXPECT_EQ(a, 0U);
+    EXPECT_EQ(b, 1U);
+    EXPECT_EQ(strings.Intern(std::string("abc")), a);
+    EXPECT_EQ(strings.Intern(""), e);
+    EXPECT_EQ(strings.size(), 3ULL);
+
+    EXPECT_EQ(strings.View(a), "abc");
+    EXPECT_EQ(strings.View(e), "");
+    EXPECT_EQ(strings.Id("abd"), b);
+    EXPECT_EQ(strings.Id("ab"), TStringPool<>::NotFound);
+    EXPECT_FALSE(strings.Exists("abcd"));
+    EXPECT_EQ(strings.size(), 3ULL);
+}
+
+TEST(TStringPool, Rehash) {
+    TStringPool<> strings(64);
+    std::string_view first;
+    for(ui32 round=0; round<2; ++round)
+        for(ui32 i=0; i<10000; ++i) {
+            std::string s = std::to_string(i * 7919);
+            EXPECT_EQ(strings.Intern(s), i);
+            if (i == 0 && round == 0)
+                first = strings.View(0);
+        }
+    EXPECT_EQ(strings.size(), 10000ULL);
+    EXPECT_EQ(strings.View(0).data(), first.data()); // views are stable
+    for(ui32 i=0; i<10000; ++i)
+        EXPECT_EQ(strings.View(i), std::to_string(i * 7919));
+}